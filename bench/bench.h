@@ -0,0 +1,25 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Monotonic wall clock, in seconds
+double bench_now(void);
+
+// Deterministic filler so runs are comparable
+void bench_fill(uint8_t *buf, size_t len, uint32_t seed);
+
+// Calls fn over and over, and returns the best rate it managed in calls/s
+double bench_measure(void (*fn)(void *arg), void *arg);
+// Prints a result line: name, bytes per op (0 if that doesn't apply), ops/s,
+// MB/s, cycles/op and cycles/byte, in fixed columns
+void bench_report(const char *name, size_t bytes, double ops_per_sec);
+
+void bench_cache(void);
+void bench_config(void);
+void bench_crc32(void);
+void bench_ed25519(void);
+void bench_sha512(void);
+
+#endif
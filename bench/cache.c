@@ -0,0 +1,104 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "bench.h"
+#include "cache.h"
+#include "util.h"
+
+// a whole season of signed demos, and then some
+#define NENTRIES (64 << 10)
+
+struct _key_run {
+	struct cache *cache;
+	const unsigned char (*keys)[32];
+	size_t nkeys;
+	size_t next;
+	size_t hits;
+};
+
+// One lookup per call, cycling through the keys so it isn't all one cache line
+static void _find_key_run(void *arg) {
+	struct _key_run *run = arg;
+	run->hits += cache_find_key(run->cache, run->keys[run->next]) != NULL;
+	if (++run->next == run->nkeys) run->next = 0;
+}
+
+static void _bench_find_key(size_t n) {
+	// never saved, so nothing gets written
+	struct cache *cache = cache_load("bench-cache-unused.txt");
+
+	unsigned char (*keys)[32] = malloc(n * 2 * sizeof keys[0]);
+	bench_fill((uint8_t *)keys, n * 2 * sizeof keys[0], 0xCAC4E + n);
+
+	// old enough that cache_put takes them; half the keys never go in
+	for (size_t i = 0; i < n; ++i) {
+		struct cache_entry e = { 0 };
+		e.id.dev = 1;
+		e.id.ino = i + 1;
+		e.id.mtime_ns = e.id.ctime_ns = INT64_C(1000000000) * 1000000000;
+		e.kind = CACHE_SIG;
+		memcpy(e.sig.key, keys[i], sizeof e.sig.key);
+		cache_put(cache, &e);
+	}
+
+	// a few replaced by another file's key, whose old key has to stop hitting
+	for (size_t i = 0; i < n; i += 97) {
+		struct cache_entry e = { 0 };
+		e.id.dev = 1;
+		e.id.ino = i + 1;
+		e.id.mtime_ns = e.id.ctime_ns = INT64_C(1000000000) * 1000000000 + 1;
+		e.kind = CACHE_SIG;
+		memcpy(e.sig.key, keys[n + i], sizeof e.sig.key);
+		cache_put(cache, &e);
+	}
+
+	for (size_t i = 0; i < n * 2; ++i) {
+		bool want = i < n ? i % 97 != 0 : (i - n) % 97 == 0;
+		const struct cache_entry *e = cache_find_key(cache, keys[i]);
+		if ((e != NULL) != want || (e && memcmp(e->sig.key, keys[i], sizeof e->sig.key))) {
+			printf("cache_find_key: MISMATCH on key %zu of %zu\n", i, n);
+			exit(1);
+		}
+	}
+
+	struct _key_run run = { cache, (const unsigned char (*)[32])keys, n, 0, 0 };
+	char label[64];
+	snprintf(label, sizeof label, "cache_find_key/%zu", n);
+	bench_report(label, 0, bench_measure(_find_key_run, &run));
+
+	free(keys);
+	cache_free(cache);
+}
+
+// util_file_id's times are what cache_put compares against time(NULL), so
+// they'd better be on the same clock: a file we've just written can't be from
+// the future, or from before last year
+static void _check_file_id(void) {
+	const char *path = "bench-cache-id.tmp";
+	FILE *f = fopen(path, "w");
+	if (!f) return;
+	fputs("mdp\n", f);
+	fclose(f);
+
+	struct util_file_id id;
+	bool ok = util_file_id(path, &id);
+	remove(path);
+
+	int64_t now = time(NULL);
+	if (!ok || id.mtime_ns / 1000000000 > now + 1 || id.mtime_ns / 1000000000 < now - 366 * 24 * 60 * 60
+		|| id.ctime_ns / 1000000000 > now + 1 || id.ctime_ns / 1000000000 < now - 366 * 24 * 60 * 60) {
+		printf("util_file_id: times aren't unix time (mtime %" PRId64 "ns, ctime %" PRId64 "ns, now %" PRId64 "s)\n", id.mtime_ns, id.ctime_ns, now);
+		exit(1);
+	}
+}
+
+void bench_cache(void) {
+	_check_file_id();
+	_bench_find_key(1024);
+	_bench_find_key(NENTRIES);
+}
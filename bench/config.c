@@ -0,0 +1,361 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "config.h"
+#include "util.h"
+
+// Roughly the shape of a real whitelist: a few hundred entries, mostly
+// under a handful of shared stems
+#define NPREFIXES 400
+#define NCMDS 4096
+// and a VPK directory whitelist
+#define NVARS 2000
+#define NPATHS 4096
+// and a full-game list with a community map pack or two
+#define NMAPS 600
+#define NDEMOS 4096
+
+static const char *const _stems[] = { "sar_", "cl_", "r_", "mat_", "sv_", "ui_", "+", "-", "" };
+
+static const char *const _dirs[] = { "materials/", "materials/models/props/", "materials/signage/", "models/props/", "sound/vo/", "scripts/vscripts/" };
+
+static uint32_t _rand(uint32_t *state) {
+	*state = *state * 1103515245 + 12345;
+	return *state >> 8;
+}
+
+static void _rand_word(uint32_t *state, char *out, size_t min, size_t max) {
+	size_t len = min + _rand(state) % (max - min + 1);
+	for (size_t i = 0; i < len; ++i) out[i] = 'a' + _rand(state) % 26;
+	out[len] = 0;
+}
+
+// Flips about a third of the letters, since the check ignores case
+static void _rand_case(uint32_t *state, char *str) {
+	for (; *str; ++str) {
+		if (*str >= 'a' && *str <= 'z' && _rand(state) % 3 == 0) *str -= 'a' - 'A';
+	}
+}
+
+// The original linear scan, which the trie is checked against
+static bool _check_linear(char **prefixes, const char *cmd) {
+	for (; *prefixes; ++prefixes) {
+		if (util_is_prefix_i(*prefixes, cmd)) return true;
+	}
+	return false;
+}
+
+struct _cmd_run {
+	char **prefixes;
+	const struct cmd_whitelist *list;
+	char **cmds;
+	size_t hits;
+};
+
+static void _linear_run(void *arg) {
+	struct _cmd_run *run = arg;
+	run->hits = 0;
+	for (size_t i = 0; i < NCMDS; ++i) run->hits += _check_linear(run->prefixes, run->cmds[i]);
+}
+
+static void _trie_run(void *arg) {
+	struct _cmd_run *run = arg;
+	run->hits = 0;
+	for (size_t i = 0; i < NCMDS; ++i) run->hits += config_check_cmd_whitelist(run->list, run->cmds[i]);
+}
+
+static void _bench_cmd_whitelist(void) {
+	uint32_t state = 0xC0FFEE;
+	size_t nstems = sizeof _stems / sizeof _stems[0];
+
+	char **prefixes = malloc((NPREFIXES + 1) * sizeof prefixes[0]);
+	for (size_t i = 0; i < NPREFIXES; ++i) {
+		char word[16];
+		_rand_word(&state, word, 2, 12);
+		prefixes[i] = malloc(32);
+		snprintf(prefixes[i], 32, "%s%s", _stems[_rand(&state) % nstems], word);
+		_rand_case(&state, prefixes[i]);
+	}
+	prefixes[NPREFIXES] = NULL;
+
+	// half are an entry with arguments after it, half are some other command
+	// under the same stems, which gets partway down the trie before missing
+	char **cmds = malloc(NCMDS * sizeof cmds[0]);
+	for (size_t i = 0; i < NCMDS; ++i) {
+		char word[16];
+		_rand_word(&state, word, 1, 12);
+		cmds[i] = malloc(64);
+		if (i % 2) {
+			snprintf(cmds[i], 64, "%s%s 1", prefixes[_rand(&state) % NPREFIXES], word);
+		} else {
+			snprintf(cmds[i], 64, "%s%s", _stems[_rand(&state) % nstems], word);
+		}
+		_rand_case(&state, cmds[i]);
+	}
+
+	struct cmd_whitelist *list = config_compile_cmd_whitelist(prefixes);
+
+	// every command, plus each entry itself and each entry cut short by one
+	for (size_t i = 0; i < NCMDS; ++i) {
+		if (config_check_cmd_whitelist(list, cmds[i]) != _check_linear(prefixes, cmds[i])) {
+			printf("cmd_whitelist: MISMATCH on '%s'\n", cmds[i]);
+			exit(1);
+		}
+	}
+	for (size_t i = 0; i < NPREFIXES; ++i) {
+		char cut[32];
+		strcpy(cut, prefixes[i]);
+		if (!config_check_cmd_whitelist(list, cut)) {
+			printf("cmd_whitelist: MISMATCH on '%s'\n", cut);
+			exit(1);
+		}
+		cut[strlen(cut) - 1] = 0;
+		if (config_check_cmd_whitelist(list, cut) != _check_linear(prefixes, cut)) {
+			printf("cmd_whitelist: MISMATCH on '%s'\n", cut);
+			exit(1);
+		}
+	}
+
+	struct _cmd_run run = { prefixes, list, cmds, 0 };
+	bench_report("cmd_whitelist/linear", 0, bench_measure(_linear_run, &run) * NCMDS);
+	bench_report("cmd_whitelist/trie", 0, bench_measure(_trie_run, &run) * NCMDS);
+
+	config_free_cmd_whitelist(list);
+	for (size_t i = 0; i < NCMDS; ++i) free(cmds[i]);
+	free(cmds);
+	for (size_t i = 0; i < NPREFIXES; ++i) free(prefixes[i]);
+	free(prefixes);
+}
+
+// The original suffix scan, which the var trie is checked against
+static int _check_var_linear(const struct config_var *vars, bool any_val_star, const char *var, const char *val) {
+	bool found = false;
+	for (; vars->name; ++vars) {
+		size_t var_len = strlen(var);
+		size_t name_len = strlen(vars->name);
+		if (var_len < name_len) continue;
+		if (strcmp(vars->name, "*") && strcmp(var + var_len - name_len, vars->name)) continue;
+
+		found = true;
+		if (!vars->val || (any_val_star && !strcmp(vars->val, "*")) || !strcmp(vars->val, val)) return 2;
+	}
+	return found ? 1 : 0;
+}
+
+struct _var_run {
+	const struct config_var *vars;
+	const struct var_whitelist *list;
+	char **paths;
+	char **sums;
+	size_t hits;
+};
+
+static void _var_linear_run(void *arg) {
+	struct _var_run *run = arg;
+	run->hits = 0;
+	for (size_t i = 0; i < NPATHS; ++i) run->hits += _check_var_linear(run->vars, true, run->paths[i], run->sums[i]);
+}
+
+static void _var_trie_run(void *arg) {
+	struct _var_run *run = arg;
+	run->hits = 0;
+	for (size_t i = 0; i < NPATHS; ++i) run->hits += config_check_var_whitelist(run->list, run->paths[i], run->sums[i]);
+}
+
+// A VPK directory whitelist's worth of file paths, checked against the
+// entries of one big VPK
+static void _bench_var_whitelist(void) {
+	uint32_t state = 0xBEEF;
+	size_t ndirs = sizeof _dirs / sizeof _dirs[0];
+
+	// a few entries are bare file names, matching that file in any directory;
+	// a few have no value or *, and one is a * that only matches a checksum
+	// nothing has
+	struct config_var *vars = malloc((NVARS + 1) * sizeof vars[0]);
+	for (size_t i = 0; i < NVARS; ++i) {
+		char word[16];
+		_rand_word(&state, word, 3, 10);
+		vars[i].name = malloc(64 + 9);
+		if (i == 0) {
+			strcpy(vars[i].name, "*");
+		} else if (i % 16 == 0) {
+			snprintf(vars[i].name, 64, "%s.vmt", word);
+		} else {
+			snprintf(vars[i].name, 64, "%s%s.vtf", _dirs[_rand(&state) % ndirs], word);
+		}
+
+		vars[i].val = vars[i].name + 64;
+		uint32_t r = _rand(&state);
+		if (i == 0) {
+			strcpy(vars[i].val, "FFFFFFFF");
+		} else if (r % 32 == 0) {
+			vars[i].val = NULL;
+		} else if (r % 32 == 1) {
+			strcpy(vars[i].val, "*");
+		} else {
+			snprintf(vars[i].val, 9, "%08X", _rand(&state) & 0xFFFFFF);
+		}
+	}
+	vars[NVARS].name = NULL;
+
+	// mostly whitelisted files, with the listed checksum or another, and the
+	// rest files that aren't there at all
+	char **paths = malloc(NPATHS * sizeof paths[0]);
+	char **sums = malloc(NPATHS * sizeof sums[0]);
+	for (size_t i = 0; i < NPATHS; ++i) {
+		const struct config_var *var = &vars[1 + _rand(&state) % (NVARS - 1)];
+		paths[i] = malloc(128);
+		sums[i] = malloc(9);
+		uint32_t r = _rand(&state);
+		if (r % 4 == 0) {
+			char word[16];
+			_rand_word(&state, word, 3, 10);
+			snprintf(paths[i], 128, "%s%s.vtf", _dirs[_rand(&state) % ndirs], word);
+		} else {
+			snprintf(paths[i], 128, "%s%s", strchr(var->name, '/') ? "" : _dirs[_rand(&state) % ndirs], var->name);
+		}
+		if (r % 4 == 1 && var->val) {
+			strcpy(sums[i], var->val);
+		} else {
+			snprintf(sums[i], 9, "%08X", _rand(&state) & 0xFFFFFF);
+		}
+	}
+
+	// with and without the *, as a value and as a name, against every path
+	// and the empty one, which even * doesn't match
+	for (int i = 0; i < 4; ++i) {
+		const struct config_var *v = i & 1 ? vars + 1 : vars;
+		bool any_val_star = i & 2;
+		struct var_whitelist *list = config_compile_var_whitelist(v, any_val_star);
+		for (size_t j = 0; j <= NPATHS; ++j) {
+			const char *path = j < NPATHS ? paths[j] : "";
+			const char *sum = j < NPATHS ? sums[j] : "*";
+			if (config_check_var_whitelist(list, path, sum) != _check_var_linear(v, any_val_star, path, sum)) {
+				printf("var_whitelist: MISMATCH on '%s' '%s'\n", path, sum);
+				exit(1);
+			}
+		}
+		config_free_var_whitelist(list);
+	}
+
+	// a real list doesn't have the *
+	struct var_whitelist *list = config_compile_var_whitelist(vars + 1, true);
+	struct _var_run run = { vars + 1, list, paths, sums, 0 };
+	bench_report("var_whitelist/linear", 0, bench_measure(_var_linear_run, &run) * NPATHS);
+	bench_report("var_whitelist/trie", 0, bench_measure(_var_trie_run, &run) * NPATHS);
+
+	config_free_var_whitelist(list);
+	for (size_t i = 0; i < NPATHS; ++i) {
+		free(paths[i]);
+		free(sums[i]);
+	}
+	free(paths);
+	free(sums);
+	for (size_t i = 0; i < NVARS; ++i) free(vars[i].name);
+	free(vars);
+}
+
+struct _maps_run {
+	char **names;
+	const struct expected_maps *maps;
+	struct map_found *found;
+	bool *linear_found;
+	char **demo_maps;
+};
+
+// The original scan over every expected map for each demo
+static void _maps_linear_run(void *arg) {
+	struct _maps_run *run = arg;
+	for (size_t i = 0; i < NDEMOS; ++i) {
+		for (size_t j = 0; j < NMAPS; ++j) {
+			if (!strcmp(run->names[j], run->demo_maps[i])) run->linear_found[j] = true;
+		}
+	}
+}
+
+static void _maps_hash_run(void *arg) {
+	struct _maps_run *run = arg;
+	for (size_t i = 0; i < NDEMOS; ++i) config_mark_map_found(run->maps, run->found, run->demo_maps[i]);
+}
+
+static void _bench_expected_maps(void) {
+	uint32_t state = 0x3A95;
+
+	// every 50th line repeats an earlier one, the way lists get pasted together
+	char **names = malloc(NMAPS * sizeof names[0]);
+	const char *path = "bench-expected-maps.tmp";
+	FILE *f = fopen(path, "w");
+	if (!f) return;
+	for (size_t i = 0; i < NMAPS; ++i) {
+		names[i] = malloc(32);
+		if (i > 0 && i % 50 == 0) {
+			strcpy(names[i], names[_rand(&state) % i]);
+		} else {
+			char word[16];
+			_rand_word(&state, word, 4, 12);
+			snprintf(names[i], 32, "sp_a%u_%s", (unsigned)(i % 5 + 1), word);
+		}
+		fprintf(f, "%s\n", names[i]);
+	}
+	fclose(f);
+
+	struct expected_maps *maps = config_read_expected_maps(path);
+	remove(path);
+	if (!maps || config_expected_maps_count(maps) != NMAPS) {
+		printf("expected_maps: MISMATCH reading %d lines\n", NMAPS);
+		exit(1);
+	}
+
+	// three quarters of the demos are on a listed map, the rest on one that
+	// isn't; about a third of the list never comes up
+	char **demo_maps = malloc(NDEMOS * sizeof demo_maps[0]);
+	for (size_t i = 0; i < NDEMOS; ++i) {
+		demo_maps[i] = malloc(32);
+		if (i % 4) {
+			strcpy(demo_maps[i], names[_rand(&state) % (NMAPS * 2 / 3)]);
+		} else {
+			char word[16];
+			_rand_word(&state, word, 4, 12);
+			snprintf(demo_maps[i], 32, "mp_coop_%s", word);
+		}
+	}
+
+	// two workers taking alternate demos and merging at the end have to find
+	// the same maps as the original scan, duplicates included
+	bool *linear_found = calloc(NMAPS, sizeof linear_found[0]);
+	struct map_found found, other;
+	config_init_map_found(&found, maps);
+	config_init_map_found(&other, maps);
+	struct _maps_run run = { names, maps, &found, linear_found, demo_maps };
+	_maps_linear_run(&run);
+	for (size_t i = 0; i < NDEMOS; ++i) config_mark_map_found(maps, i % 2 ? &other : &found, demo_maps[i]);
+	config_merge_map_found(&found, &other);
+	for (size_t j = 0; j < NMAPS; ++j) {
+		if (config_is_map_found(&found, j) != linear_found[j]) {
+			printf("expected_maps: MISMATCH on '%s' (line %zu)\n", names[j], j + 1);
+			exit(1);
+		}
+	}
+
+	bench_report("expected_maps/linear", 0, bench_measure(_maps_linear_run, &run) * NDEMOS);
+	bench_report("expected_maps/hash", 0, bench_measure(_maps_hash_run, &run) * NDEMOS);
+
+	config_free_map_found(&found);
+	config_free_map_found(&other);
+	config_free_expected_maps(maps);
+	free(linear_found);
+	for (size_t i = 0; i < NDEMOS; ++i) free(demo_maps[i]);
+	free(demo_maps);
+	for (size_t i = 0; i < NMAPS; ++i) free(names[i]);
+	free(names);
+}
+
+void bench_config(void) {
+	_bench_cmd_whitelist();
+	_bench_var_whitelist();
+	_bench_expected_maps();
+}
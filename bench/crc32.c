@@ -0,0 +1,140 @@
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "crc32.h"
+#include "util.h"
+
+// Built a bit at a time rather than taken from crc_table.h, so a bad
+// generated table can't agree with itself
+static uint32_t _table[256];
+
+static void _init_table(void) {
+	for (uint32_t b = 0; b < 256; ++b) {
+		uint32_t crc = b;
+		for (int i = 0; i < 8; ++i) crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320 : crc >> 1;
+		_table[b] = crc;
+	}
+}
+
+// The original byte-at-a-time loop, which everything is checked against
+static uint32_t _crc_bytewise(uint32_t crc, const uint8_t *data, size_t len) {
+	for (size_t i = 0; i < len; ++i) {
+		uint8_t lookup_idx = (crc ^ data[i]) & 0xFF;
+		crc = (crc >> 8) ^ _table[lookup_idx];
+	}
+	return crc;
+}
+
+struct _crc_run {
+	uint32_t (*fn)(uint32_t, const uint8_t *, size_t);
+	const uint8_t *buf;
+	size_t len;
+	uint32_t out;
+};
+
+static void _crc_run(void *arg) {
+	struct _crc_run *run = arg;
+	run->out = run->fn(0xFFFFFFFF, run->buf, run->len);
+}
+
+// Times fn at every size, checking its answer against the bytewise loop
+static void _measure(const char *name, uint32_t (*fn)(uint32_t, const uint8_t *, size_t), const uint8_t *buf, const size_t *sizes, size_t nsizes) {
+	for (size_t i = 0; i < nsizes; ++i) {
+		struct _crc_run run = { fn, buf, sizes[i], 0 };
+		double rate = bench_measure(_crc_run, &run);
+		if (run.out != _crc_bytewise(0xFFFFFFFF, buf, sizes[i])) {
+			printf("crc32 %s: MISMATCH at length %zu\n", name, sizes[i]);
+			exit(1);
+		}
+
+		char label[64];
+		snprintf(label, sizeof label, "crc32/%s", name);
+		bench_report(label, sizes[i], rate);
+	}
+}
+
+static void _check(const struct crc32_impl *impl, const char *what, const uint8_t *buf, size_t len) {
+	// chained from a nonstandard state too, like the demo hashing does
+	uint32_t want = _crc_bytewise(0xFFFFFFFF, buf, len);
+	uint32_t want_chained = _crc_bytewise(0x12345678, buf, len);
+	if (impl->fn(0xFFFFFFFF, buf, len) != want || impl->fn(0x12345678, buf, len) != want_chained) {
+		printf("crc32 %s: MISMATCH on %s (%zu bytes)\n", impl->name, what, len);
+		exit(1);
+	}
+}
+
+// The bundled demos, if we're run from the repo
+static void _check_demos(const struct crc32_impl *impl) {
+	DIR *d = opendir("demos");
+	if (!d) return;
+
+	struct dirent *ent;
+	while ((ent = readdir(d))) {
+		if (ent->d_name[0] == '.') continue;
+
+		char path[512];
+		snprintf(path, sizeof path, "demos/%s", ent->d_name);
+
+		struct util_mapping map;
+		if (!util_map_file(path, &map)) continue;
+		_check(impl, path, map.data, map.size);
+		util_unmap_file(&map);
+	}
+
+	closedir(d);
+}
+
+// Splitting a buffer anywhere and combining the halves has to give the same
+// answer as doing it in one go, which is what the background demo hashing
+// relies on
+static void _check_combine(const uint8_t *buf, size_t len) {
+	uint32_t want = ~_crc_bytewise(0xFFFFFFFF, buf, len);
+	for (size_t split = 0; split <= len; split += split < 64 ? 1 : 977) {
+		uint32_t a = ~crc32_update(0xFFFFFFFF, buf, split);
+		uint32_t b = ~crc32_update(0xFFFFFFFF, buf + split, len - split);
+		if (crc32_combine(a, b, len - split) != want) {
+			printf("crc32_combine: MISMATCH splitting %zu bytes at %zu\n", len, split);
+			exit(1);
+		}
+	}
+}
+
+void bench_crc32(void) {
+	static const size_t sizes[] = { 64, 1024, 64 << 10, 1 << 20, 16 << 20 };
+	size_t max = sizes[sizeof sizes / sizeof sizes[0] - 1];
+
+	_init_table();
+
+	// offset by one so the kernels see an unaligned buffer
+	uint8_t *buf = malloc(max + 1);
+	bench_fill(buf, max + 1, 0xC0FFEE);
+
+	// correctness first: every length and alignment across the thresholds
+	// where the kernels switch over
+	for (size_t i = 0; i < g_crc32_nimpls; ++i) {
+		const struct crc32_impl *impl = &g_crc32_impls[i];
+		if (!impl->supported()) continue;
+
+		for (size_t off = 0; off < 8; ++off) {
+			for (size_t len = 0; len < 1100 && off + len <= max; ++len) {
+				_check(impl, "random data", buf + off, len);
+			}
+		}
+		_check(impl, "random data", buf + 1, max);
+		_check_demos(impl);
+	}
+	_check_combine(buf + 1, 100000);
+
+	size_t nsizes = sizeof sizes / sizeof sizes[0];
+	_measure("bytewise", _crc_bytewise, buf + 1, sizes, nsizes);
+	for (size_t j = 0; j < g_crc32_nimpls; ++j) {
+		const struct crc32_impl *impl = &g_crc32_impls[j];
+		if (impl->supported()) _measure(impl->name, impl->fn, buf + 1, sizes, nsizes);
+	}
+
+	free(buf);
+}
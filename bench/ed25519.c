@@ -0,0 +1,281 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "ed25519/ed25519.h"
+#include "ed25519/ge.h"
+
+#define MSG_LEN 256
+// a longer message too, for how much the hashing adds
+#define LONG_MSG_LEN (64 << 10)
+#define NKEYS 16
+#define BATCH 64
+
+// Every signature has to get the same answer from the fixed-key path as from
+// plain ed25519_verify, good or tampered with
+static void _check(const uint8_t *msg, const unsigned char *sig, const unsigned char *pub, const ed25519_fixed_key *key) {
+	int want = ed25519_verify(sig, msg, MSG_LEN, pub);
+	if (ed25519_verify_fixed(sig, msg, MSG_LEN, key) != want) {
+		printf("ed25519_verify_fixed: MISMATCH (expected %d)\n", want);
+		exit(1);
+	}
+}
+
+struct _verify_run {
+	const uint8_t *msg;
+	size_t len;
+	const unsigned char *sig;
+	const unsigned char *pub;
+	const ed25519_fixed_key *key; // or NULL for plain ed25519_verify
+};
+
+static void _verify_run(void *arg) {
+	struct _verify_run *run = arg;
+	int ok = run->key ? ed25519_verify_fixed(run->sig, run->msg, run->len, run->key) : ed25519_verify(run->sig, run->msg, run->len, run->pub);
+	if (!ok) {
+		printf("ed25519: good signature failed to verify\n");
+		exit(1);
+	}
+}
+
+// A batch of signatures over different messages, all by one key (which is
+// put in fixed) if fixed is given, or by one of a few keys otherwise
+struct _batch {
+	uint8_t msgs[BATCH][MSG_LEN];
+	unsigned char sigs[BATCH][64];
+	unsigned char pubs[BATCH][32];
+	ed25519_verify_context ctxs[BATCH];
+	int valid[BATCH];
+	ed25519_fixed_key *fixed; // or NULL for a key per signature
+};
+
+static void _make_batch(struct _batch *b, bool fixed) {
+	unsigned char seed[32], pub[32], priv[64];
+	b->fixed = NULL;
+	for (int i = 0; i < BATCH; ++i) {
+		if (i == 0 || (!fixed && i % 5 == 0)) {
+			bench_fill(seed, sizeof seed, 0xBEEF + i);
+			ed25519_create_keypair(pub, priv, seed);
+			if (fixed) b->fixed = ed25519_fixed_key_create(pub);
+		}
+		bench_fill(b->msgs[i], MSG_LEN, 0xBA7C + i);
+		ed25519_sign(b->sigs[i], b->msgs[i], MSG_LEN, pub, priv);
+		memcpy(b->pubs[i], pub, 32);
+	}
+}
+
+static int _verify_batch(struct _batch *b, const ed25519_fixed_key *fixed) {
+	for (int i = 0; i < BATCH; ++i) {
+		if (fixed) {
+			ed25519_verify_init_fixed(&b->ctxs[i], b->sigs[i], fixed);
+		} else {
+			ed25519_verify_init(&b->ctxs[i], b->sigs[i], b->pubs[i]);
+		}
+		ed25519_verify_update(&b->ctxs[i], b->msgs[i], MSG_LEN);
+	}
+	return ed25519_verify_batch(b->ctxs, BATCH, b->valid);
+}
+
+static void _batch_run(void *arg) {
+	struct _batch *b = arg;
+	if (!_verify_batch(b, b->fixed)) {
+		printf("ed25519: good batch failed to verify\n");
+		exit(1);
+	}
+}
+
+// The batch has to agree with checking each signature on its own, with any
+// number of bad ones mixed in
+static void _check_batch(struct _batch *b, const ed25519_fixed_key *fixed) {
+	static const int bad[][3] = { { -1 }, { 0, -1 }, { 63, -1 }, { 5, 40, -1 }, { 17, 18, 19 } };
+	for (size_t t = 0; t < sizeof bad / sizeof bad[0]; ++t) {
+		for (int j = 0; j < 3 && bad[t][j] >= 0; ++j) {
+			b->sigs[bad[t][j]][t % 2 ? 3 : 40] ^= 0x10;
+		}
+
+		int all = _verify_batch(b, fixed);
+		int want_all = 1;
+		for (int i = 0; i < BATCH; ++i) {
+			int want = ed25519_verify(b->sigs[i], b->msgs[i], MSG_LEN, b->pubs[i]);
+			want_all &= want;
+			if (b->valid[i] != want) {
+				printf("ed25519_verify_batch: MISMATCH at %d (expected %d)\n", i, want);
+				exit(1);
+			}
+		}
+		if (all != want_all) {
+			printf("ed25519_verify_batch: MISMATCH overall (expected %d)\n", want_all);
+			exit(1);
+		}
+
+		for (int j = 0; j < 3 && bad[t][j] >= 0; ++j) {
+			b->sigs[bad[t][j]][t % 2 ? 3 : 40] ^= 0x10;
+		}
+	}
+}
+
+// The wide-window double scalar multiplication verify uses has to land on
+// the same point as the original width-5 one, for any pair of scalars below
+// 2^253 (which is all verify ever passes it)
+static void _check_scalarmult(const ge_p3 *A, unsigned char (*scalars)[32], int n) {
+	for (int i = 0; i + 1 < n; ++i) {
+		ge_p2 wide, compact;
+		unsigned char w[32], c[32];
+		ge_double_scalarmult_vartime(&wide, scalars[i], A, scalars[i + 1]);
+		ge_double_scalarmult_vartime_compact(&compact, scalars[i], A, scalars[i + 1]);
+		ge_tobytes(w, &wide);
+		ge_tobytes(c, &compact);
+		if (memcmp(w, c, 32) != 0) {
+			printf("ge_double_scalarmult_vartime: MISMATCH at %d\n", i);
+			exit(1);
+		}
+	}
+}
+
+struct _scalarmult_run {
+	const ge_p3 *A;
+	unsigned char (*scalars)[32];
+	int n;
+	int next;
+	int compact;
+};
+
+// one multiplication per call, cycling through the scalars
+static void _scalarmult_run(void *arg) {
+	struct _scalarmult_run *run = arg;
+	int i = run->next;
+	ge_p2 r;
+	if (run->compact) {
+		ge_double_scalarmult_vartime_compact(&r, run->scalars[i], run->A, run->scalars[i + 1]);
+	} else {
+		ge_double_scalarmult_vartime(&r, run->scalars[i], run->A, run->scalars[i + 1]);
+	}
+	run->next = (i + 1) % (run->n - 1);
+}
+
+static void _bench_scalarmult(const unsigned char *pub) {
+	enum { NSCALARS = 64 };
+	unsigned char scalars[NSCALARS][32];
+	ge_p3 A;
+	if (ge_frombytes_negate_vartime(&A, pub) != 0) {
+		printf("ge_frombytes_negate_vartime: rejected a good key\n");
+		exit(1);
+	}
+
+	// zero, one and the largest value, then random ones
+	memset(scalars[0], 0, 32);
+	memset(scalars[1], 0, 32);
+	scalars[1][0] = 1;
+	memset(scalars[2], 0xff, 32);
+	scalars[2][31] = 0x1f;
+	for (int i = 3; i < NSCALARS; ++i) {
+		bench_fill(scalars[i], 32, 0x5CA1 + i);
+		scalars[i][31] &= 0x1f;
+	}
+
+	_check_scalarmult(&A, scalars, NSCALARS);
+
+	struct _scalarmult_run run = { &A, scalars, NSCALARS, 0, 0 };
+	bench_report("ge_double_scalarmult_vartime", 0, bench_measure(_scalarmult_run, &run));
+	run.compact = 1;
+	bench_report("ge_double_scalarmult_vartime_compact", 0, bench_measure(_scalarmult_run, &run));
+}
+
+// The field operations are far too quick to time one at a time, so each call
+// chains FE_CHAIN of them, every one depending on the last
+#define FE_CHAIN 1000
+
+struct _fe_run {
+	fe f;
+	fe g;
+};
+
+static void _fe_mul_run(void *arg) {
+	struct _fe_run *run = arg;
+	for (int i = 0; i < FE_CHAIN; ++i) {
+		fe_mul(run->f, run->f, run->g);
+	}
+}
+
+static void _fe_sq_run(void *arg) {
+	struct _fe_run *run = arg;
+	for (int i = 0; i < FE_CHAIN; ++i) {
+		fe_sq(run->f, run->f);
+	}
+}
+
+static void _bench_fe(void) {
+	unsigned char bytes[32];
+	struct _fe_run run;
+	bench_fill(bytes, sizeof bytes, 0xFE);
+	fe_frombytes(run.f, bytes);
+	bench_fill(bytes, sizeof bytes, 0xEF);
+	fe_frombytes(run.g, bytes);
+
+	bench_report("fe_mul", 0, bench_measure(_fe_mul_run, &run) * FE_CHAIN);
+	bench_report("fe_sq", 0, bench_measure(_fe_sq_run, &run) * FE_CHAIN);
+}
+
+void bench_ed25519(void) {
+	uint8_t msg[MSG_LEN];
+	unsigned char seed[32], pub[32], priv[64], sig[64];
+	ed25519_fixed_key *key = NULL;
+
+	for (int i = 0; i < NKEYS; ++i) {
+		bench_fill(seed, sizeof seed, 0x5EED + i);
+		bench_fill(msg, sizeof msg, 0xD00D + i);
+		ed25519_create_keypair(pub, priv, seed);
+		ed25519_sign(sig, msg, sizeof msg, pub, priv);
+		ed25519_fixed_key_free(key);
+		key = ed25519_fixed_key_create(pub);
+
+		_check(msg, sig, pub, key);
+		for (int bit = 0; bit < 512; bit += 37) {
+			sig[bit / 8] ^= 1 << (bit % 8);
+			_check(msg, sig, pub, key);
+			sig[bit / 8] ^= 1 << (bit % 8);
+		}
+		msg[0] ^= 1;
+		_check(msg, sig, pub, key);
+		msg[0] ^= 1;
+	}
+
+	_bench_fe();
+	_bench_scalarmult(pub);
+
+	struct _batch *b = malloc(sizeof *b);
+	_make_batch(b, false);
+	_check_batch(b, NULL);
+	_make_batch(b, true);
+	_check_batch(b, b->fixed);
+
+	uint8_t *long_msg = malloc(LONG_MSG_LEN);
+	unsigned char long_sig[64];
+	bench_fill(long_msg, LONG_MSG_LEN, 0x10A6);
+	ed25519_sign(long_sig, long_msg, LONG_MSG_LEN, pub, priv);
+
+	struct _verify_run runs[] = {
+		{ msg, MSG_LEN, sig, pub, NULL },
+		{ long_msg, LONG_MSG_LEN, long_sig, pub, NULL },
+	};
+	for (size_t i = 0; i < sizeof runs / sizeof runs[0]; ++i) {
+		bench_report("ed25519_verify", runs[i].len, bench_measure(_verify_run, &runs[i]));
+	}
+	for (size_t i = 0; i < sizeof runs / sizeof runs[0]; ++i) {
+		runs[i].key = key;
+		bench_report("ed25519_verify_fixed", runs[i].len, bench_measure(_verify_run, &runs[i]));
+	}
+
+	// reported per signature
+	char label[64];
+	snprintf(label, sizeof label, "ed25519_verify_batch/%d", BATCH);
+	bench_report(label, MSG_LEN, bench_measure(_batch_run, b) * BATCH);
+
+	free(long_msg);
+	ed25519_fixed_key_free(b->fixed);
+	free(b);
+	ed25519_fixed_key_free(key);
+}
@@ -0,0 +1,146 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define BENCH_TSC
+#endif
+
+#include "bench.h"
+
+// Every result is the best of this many runs of at least this long, which
+// shrugs off most of the noise from whatever else the machine is doing
+#define BENCH_TRIALS 5
+#define BENCH_TRIAL_TIME 0.05
+
+// the parser reports through these
+FILE *g_errfile;
+FILE *g_outfile;
+
+// TSC ticks per second, or 0 if there's no cycle counter to go by
+static double _g_cycles_per_sec;
+
+double bench_now(void) {
+#ifdef _WIN32
+	LARGE_INTEGER freq, now;
+	QueryPerformanceFrequency(&freq);
+	QueryPerformanceCounter(&now);
+	return (double)now.QuadPart / freq.QuadPart;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+#endif
+}
+
+void bench_fill(uint8_t *buf, size_t len, uint32_t seed) {
+	// xorshift32
+	uint32_t x = seed ? seed : 1;
+	for (size_t i = 0; i < len; ++i) {
+		x ^= x << 13;
+		x ^= x >> 17;
+		x ^= x << 5;
+		buf[i] = x;
+	}
+}
+
+double bench_measure(void (*fn)(void *arg), void *arg) {
+	double best = 0;
+	size_t batch = 1;
+
+	for (int t = 0; t < BENCH_TRIALS; ++t) {
+		size_t calls = 0;
+		double start = bench_now(), elapsed;
+		do {
+			double lap = bench_now();
+			for (size_t i = 0; i < batch; ++i) fn(arg);
+			calls += batch;
+
+			// only look at the clock every millisecond or so, or it'd swamp
+			// anything quick
+			double end = bench_now();
+			if (end - lap < 1e-3) batch *= 2;
+			elapsed = end - start;
+		} while (elapsed < BENCH_TRIAL_TIME);
+
+		if (calls / elapsed > best) best = calls / elapsed;
+	}
+
+	return best;
+}
+
+void bench_report(const char *name, size_t bytes, double ops_per_sec) {
+	printf("%-40s %9zu %14.1f", name, bytes, ops_per_sec);
+
+	if (bytes) {
+		printf(" %10.1f", ops_per_sec * bytes / 1e6);
+	} else {
+		printf(" %10s", "-");
+	}
+
+	if (_g_cycles_per_sec > 0) {
+		double cycles = _g_cycles_per_sec / ops_per_sec;
+		printf(" %12.1f", cycles);
+		if (bytes) {
+			printf(" %11.3f", cycles / bytes);
+		} else {
+			printf(" %11s", "-");
+		}
+	} else {
+		printf(" %12s %11s", "-", "-");
+	}
+
+	printf("\n");
+	fflush(stdout);
+}
+
+// The TSC runs at a fixed rate rather than the core clock, so it's measured
+// against the wall clock once up front
+static void _calibrate_cycles(void) {
+#ifdef BENCH_TSC
+	double start = bench_now(), elapsed;
+	uint64_t c0 = __rdtsc();
+	do {
+		elapsed = bench_now() - start;
+	} while (elapsed < 0.1);
+	_g_cycles_per_sec = (__rdtsc() - c0) / elapsed;
+#endif
+}
+
+int main(void) {
+	g_errfile = stderr;
+	g_outfile = stdout;
+
+	_calibrate_cycles();
+
+	// the header is all that varies between builds; the result lines always
+	// come out in the same order, so two runs diff line by line
+#if defined(__clang__)
+	printf("# compiler: clang %s\n", __clang_version__);
+#elif defined(__GNUC__)
+	printf("# compiler: gcc %s\n", __VERSION__);
+#endif
+#ifdef BENCH_CFLAGS
+	printf("# flags: %s\n", BENCH_CFLAGS);
+#endif
+	if (_g_cycles_per_sec > 0) {
+		printf("# cycles: TSC at %.3f GHz\n", _g_cycles_per_sec / 1e9);
+	} else {
+		printf("# cycles: no cycle counter\n");
+	}
+	printf("# %-38s %9s %14s %10s %12s %11s\n", "name", "bytes", "ops/s", "MB/s", "cycles/op", "cycles/byte");
+
+	bench_crc32();
+	bench_sha512();
+	bench_ed25519();
+	bench_config();
+	bench_cache();
+
+	return 0;
+}
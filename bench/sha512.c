@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bench.h"
+#include "ed25519/sha512.h"
+
+#define NMSGS 64
+
+static const int _widths[] = { 1, 4, 8 };
+
+// Hashes each message on its own, then all of them at once, with a head
+// already sitting in the buffer to start with, and checks the digests match
+static void _check(const uint8_t *buf, const size_t *offs, const size_t *lens, size_t head, int width) {
+	sha512_context ctx[NMSGS], want[NMSGS];
+	sha512_context *mds[NMSGS];
+	const unsigned char *ins[NMSGS];
+	unsigned char a[64], b[64];
+
+	for (int i = 0; i < NMSGS; ++i) {
+		sha512_init(&ctx[i]);
+		sha512_update(&ctx[i], buf, head);
+		want[i] = ctx[i];
+		sha512_update(&want[i], buf + offs[i], lens[i]);
+		mds[i] = &ctx[i];
+		ins[i] = buf + offs[i];
+	}
+
+	sha512_update_multi_width(mds, ins, lens, NMSGS, width);
+
+	for (int i = 0; i < NMSGS; ++i) {
+		sha512_final(&ctx[i], a);
+		sha512_final(&want[i], b);
+		if (memcmp(a, b, 64)) {
+			printf("sha512 x%d: MISMATCH on message %d (%zu bytes after %zu)\n", width, i, lens[i], head);
+			exit(1);
+		}
+	}
+}
+
+struct _sha_run {
+	const uint8_t *buf;
+	size_t len;
+	int width; // 0 for a single sha512 call
+	unsigned char out[64];
+};
+
+static void _sha_run(void *arg) {
+	struct _sha_run *run = arg;
+	if (!run->width) {
+		sha512(run->buf, run->len, run->out);
+		return;
+	}
+
+	sha512_context ctx[NMSGS];
+	sha512_context *mds[NMSGS];
+	const unsigned char *ins[NMSGS];
+	size_t lens[NMSGS];
+	for (int i = 0; i < NMSGS; ++i) {
+		sha512_init(&ctx[i]);
+		mds[i] = &ctx[i];
+		ins[i] = run->buf + i * run->len;
+		lens[i] = run->len;
+	}
+	sha512_update_multi_width(mds, ins, lens, NMSGS, run->width);
+}
+
+void bench_sha512(void) {
+	static const size_t single_sizes[] = { 64, 1024, 64 << 10, 1 << 20 };
+	static const size_t sizes[] = { 1024, 64 << 10 };
+	size_t max = sizes[sizeof sizes / sizeof sizes[0] - 1];
+	int maxwidth = sha512_multi_width();
+
+	uint8_t *buf = malloc(NMSGS * max);
+	bench_fill(buf, NMSGS * max, 0x5A512);
+
+	// ragged lengths, so lanes drop out at different times and the tails
+	// land at every position in the buffer
+	size_t offs[NMSGS], lens[NMSGS];
+	for (int i = 0; i < NMSGS; ++i) {
+		offs[i] = i * 37;
+		lens[i] = (i * 1031) % 4099;
+	}
+
+	// every width, even past what this CPU has kernels for, which has to
+	// fall back rather than give wrong digests
+	for (int width = 1; width <= 9; ++width) {
+		for (size_t head = 0; head < 130; head += 13) {
+			_check(buf, offs, lens, head, width);
+		}
+	}
+
+	for (size_t i = 0; i < sizeof single_sizes / sizeof single_sizes[0]; ++i) {
+		struct _sha_run run = { buf, single_sizes[i], 0 };
+		bench_report("sha512", single_sizes[i], bench_measure(_sha_run, &run));
+	}
+
+	// NMSGS messages per call, so that's reported per message
+	for (size_t w = 0; w < sizeof _widths / sizeof _widths[0]; ++w) {
+		if (_widths[w] > maxwidth) continue;
+		for (size_t i = 0; i < sizeof sizes / sizeof sizes[0]; ++i) {
+			struct _sha_run run = { buf, sizes[i], _widths[w] };
+			char label[64];
+			snprintf(label, sizeof label, "sha512_update_multi/x%d", _widths[w]);
+			bench_report(label, sizes[i], bench_measure(_sha_run, &run) * NMSGS);
+		}
+	}
+
+	free(buf);
+}
@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+
+#define ARENA_ALIGN 16
+#define ARENA_MIN_BLOCK (64 * 1024)
+
+struct arena_block {
+	struct arena_block *prev;
+	size_t size;
+	size_t used;
+	size_t last; // offset of the most recent allocation, for arena_realloc
+	_Alignas(ARENA_ALIGN) unsigned char data[];
+};
+
+static inline size_t _align(size_t size) {
+	return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static struct arena_block *_new_block(struct arena_block *prev, size_t min_size) {
+	size_t size = prev ? prev->size * 2 : ARENA_MIN_BLOCK;
+	while (size < min_size) size *= 2;
+
+	struct arena_block *block = malloc(sizeof *block + size);
+	if (!block) return NULL;
+
+	block->prev = prev;
+	block->size = size;
+	block->used = 0;
+	block->last = 0;
+	return block;
+}
+
+void arena_init(struct arena *arena) {
+	arena->block = NULL;
+}
+
+void *arena_alloc(struct arena *arena, size_t size) {
+	if (size > SIZE_MAX / 2) return NULL;
+	size = _align(size);
+
+	struct arena_block *block = arena->block;
+	if (!block || block->size - block->used < size) {
+		block = _new_block(block, size);
+		if (!block) return NULL;
+		arena->block = block;
+	}
+
+	block->last = block->used;
+	block->used += size;
+	return block->data + block->last;
+}
+
+void *arena_calloc(struct arena *arena, size_t n, size_t size) {
+	if (size && n > SIZE_MAX / size) return NULL;
+	void *ptr = arena_alloc(arena, n * size);
+	if (ptr) memset(ptr, 0, n * size);
+	return ptr;
+}
+
+void *arena_realloc(struct arena *arena, void *ptr, size_t old_size, size_t new_size) {
+	if (!ptr) return arena_alloc(arena, new_size);
+	if (new_size <= old_size) return ptr;
+
+	struct arena_block *block = arena->block;
+	if (ptr == block->data + block->last && new_size <= SIZE_MAX / 2 && block->size - block->last >= _align(new_size)) {
+		block->used = block->last + _align(new_size);
+		return ptr;
+	}
+
+	void *new_ptr = arena_alloc(arena, new_size);
+	if (new_ptr) memcpy(new_ptr, ptr, old_size);
+	return new_ptr;
+}
+
+char *arena_strndup(struct arena *arena, const void *str, size_t len) {
+	char *copy = arena_alloc(arena, len + 1);
+	if (!copy) return NULL;
+	memcpy(copy, str, len);
+	copy[len] = 0;
+	return copy;
+}
+
+void arena_reset(struct arena *arena) {
+	struct arena_block *block = arena->block;
+	if (!block) return;
+
+	// Only the newest (and largest) block is kept. Blocks double in size, so
+	// there are only ever a handful of older ones to drop.
+	struct arena_block *prev = block->prev;
+	while (prev) {
+		struct arena_block *next = prev->prev;
+		free(prev);
+		prev = next;
+	}
+
+	block->prev = NULL;
+	block->used = 0;
+	block->last = 0;
+}
+
+void arena_destroy(struct arena *arena) {
+	arena_reset(arena);
+	free(arena->block);
+	arena->block = NULL;
+}
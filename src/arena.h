@@ -0,0 +1,24 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Bump allocator for data that all dies at the same time (e.g. everything
+// belonging to one parsed demo). Individual allocations are never freed;
+// arena_reset drops everything at once but keeps the memory around, so an
+// arena reused for a batch of demos settles into a single block and stops
+// hitting malloc at all.
+struct arena {
+	struct arena_block *block;
+};
+
+void arena_init(struct arena *arena);
+void *arena_alloc(struct arena *arena, size_t size);
+void *arena_calloc(struct arena *arena, size_t n, size_t size);
+// Grows an allocation; done in place when it's the most recent one.
+void *arena_realloc(struct arena *arena, void *ptr, size_t old_size, size_t new_size);
+char *arena_strndup(struct arena *arena, const void *str, size_t len);
+void arena_reset(struct arena *arena);
+void arena_destroy(struct arena *arena);
+
+#endif
@@ -0,0 +1,328 @@
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "cache.h"
+
+// The file is plain text, a version line followed by one entry per line:
+//
+//   <dev> <ino> <size> <mtime> <ctime> <last used> crc <demo checksum>
+//   <dev> <ino> <size> <mtime> <ctime> <last used> sig <pass|fail> <SAR checksum> <signature> <key>
+//
+// Lines that don't parse are dropped, and a file with any other version line
+// is ignored altogether; either way it's rewritten on the next save. Bump the
+// version whenever what gets cached changes meaning.
+#define CACHE_VERSION "mdp verify cache 1"
+
+// entries nobody has looked up in this long are dropped
+#define CACHE_MAX_AGE (30 * 24 * 60 * 60)
+// last_used is only bumped once it's this stale, so a run where everything
+// hits doesn't rewrite the file just for that
+#define CACHE_TOUCH_AGE (24 * 60 * 60)
+// coarse enough for any filesystem's timestamps
+#define CACHE_RACY_AGE 2
+
+#define LINE_MAX_LEN 512
+
+struct cache {
+	char *path;
+	int64_t now;
+	bool dirty;
+	struct cache_entry *entries;
+	size_t nentries;
+	size_t entries_alloc;
+	// open addressing on (dev, ino); a slot holds an index into entries plus
+	// one, or 0 if it's empty
+	size_t *slots;
+	size_t nslots;
+	// the same again for CACHE_SIG entries on their key. An entry replaced by
+	// one with another key leaves its old slot behind, which lookups just
+	// skip; they're cleared out whenever this is rebuilt.
+	size_t *key_slots;
+	size_t nkey_slots;
+	size_t key_slots_used;
+};
+
+// Table {{{
+
+static size_t *_cache_slot(struct cache *cache, uint64_t dev, uint64_t ino) {
+	uint64_t h = (ino ^ (dev << 32 | dev >> 32)) * UINT64_C(0x9E3779B97F4A7C15);
+	size_t mask = cache->nslots - 1;
+	for (size_t i = (h >> 32) & mask;; i = (i + 1) & mask) {
+		size_t *slot = &cache->slots[i];
+		if (!*slot) return slot;
+		const struct util_file_id *id = &cache->entries[*slot - 1].id;
+		if (id->dev == dev && id->ino == ino) return slot;
+	}
+}
+
+// the key is the start of a SHA-512, so it's as good as a hash already
+static size_t _key_start(const struct cache *cache, const unsigned char *key) {
+	uint64_t h;
+	memcpy(&h, key, sizeof h);
+	return h & (cache->nkey_slots - 1);
+}
+
+static void _key_insert(struct cache *cache, size_t idx) {
+	size_t mask = cache->nkey_slots - 1;
+	size_t i = _key_start(cache, cache->entries[idx].sig.key);
+	while (cache->key_slots[i]) i = (i + 1) & mask;
+	cache->key_slots[i] = idx + 1;
+	++cache->key_slots_used;
+}
+
+static void _cache_index_key(struct cache *cache, size_t idx) {
+	if ((cache->key_slots_used + 1) * 2 <= cache->nkey_slots) {
+		_key_insert(cache, idx);
+		return;
+	}
+
+	// rebuild from scratch, which takes in idx too
+	size_t nsigs = 0;
+	for (size_t i = 0; i < cache->nentries; ++i) nsigs += cache->entries[i].kind == CACHE_SIG;
+
+	free(cache->key_slots);
+	cache->nkey_slots = 64;
+	while (cache->nkey_slots < nsigs * 4) cache->nkey_slots *= 2;
+	cache->key_slots = calloc(cache->nkey_slots, sizeof cache->key_slots[0]);
+	cache->key_slots_used = 0;
+
+	for (size_t i = 0; i < cache->nentries; ++i) {
+		if (cache->entries[i].kind == CACHE_SIG) _key_insert(cache, i);
+	}
+}
+
+static void _cache_add(struct cache *cache, const struct cache_entry *entry) {
+	if ((cache->nentries + 1) * 2 > cache->nslots) {
+		free(cache->slots);
+		cache->nslots = cache->nslots ? cache->nslots * 2 : 64;
+		cache->slots = calloc(cache->nslots, sizeof cache->slots[0]);
+		for (size_t i = 0; i < cache->nentries; ++i) {
+			const struct util_file_id *id = &cache->entries[i].id;
+			*_cache_slot(cache, id->dev, id->ino) = i + 1;
+		}
+	}
+
+	size_t *slot = _cache_slot(cache, entry->id.dev, entry->id.ino);
+	if (!*slot) {
+		if (cache->nentries == cache->entries_alloc) {
+			cache->entries_alloc = cache->entries_alloc ? cache->entries_alloc * 2 : 64;
+			cache->entries = realloc(cache->entries, cache->entries_alloc * sizeof cache->entries[0]);
+		}
+		*slot = ++cache->nentries;
+	}
+
+	cache->entries[*slot - 1] = *entry;
+	if (entry->kind == CACHE_SIG) _cache_index_key(cache, *slot - 1);
+}
+
+static bool _cache_has(struct cache *cache, const struct util_file_id *id) {
+	return cache->nslots && *_cache_slot(cache, id->dev, id->ino);
+}
+
+// }}}
+
+// File format {{{
+
+static bool _read_hex(const char *str, unsigned char *out, size_t len) {
+	if (strlen(str) != len * 2) return false;
+	for (size_t i = 0; i < len; ++i) {
+		unsigned byte;
+		if (sscanf(str + i * 2, "%2x", &byte) != 1) return false;
+		out[i] = byte;
+	}
+	return true;
+}
+
+static void _write_hex(FILE *f, const unsigned char *data, size_t len) {
+	for (size_t i = 0; i < len; ++i) {
+		fprintf(f, "%02x", data[i]);
+	}
+}
+
+static bool _parse_entry(const char *line, struct cache_entry *out) {
+	struct util_file_id *id = &out->id;
+	char kind[4];
+	int n = 0;
+	if (sscanf(line, "%" SCNu64 " %" SCNu64 " %" SCNu64 " %" SCNd64 " %" SCNd64 " %" SCNd64 " %3s %n", &id->dev, &id->ino, &id->size, &id->mtime_ns, &id->ctime_ns, &out->last_used, kind, &n) != 7 || !n) {
+		return false;
+	}
+	line += n;
+
+	if (!strcmp(kind, "crc")) {
+		out->kind = CACHE_CRC;
+		n = 0;
+		return sscanf(line, "%8" SCNx32 " %n", &out->crc, &n) == 1 && n && !line[n];
+	}
+
+	if (!strcmp(kind, "sig")) {
+		char verdict[5], signature[129], key[65];
+		out->kind = CACHE_SIG;
+		n = 0;
+		if (sscanf(line, "%4s %8" SCNx32 " %128s %64s %n", verdict, &out->sig.sar_sum, signature, key, &n) != 4 || !n || line[n]) {
+			return false;
+		}
+		if (strcmp(verdict, "pass") && strcmp(verdict, "fail")) return false;
+		out->sig.valid = !strcmp(verdict, "pass");
+		return _read_hex(signature, out->sig.signature, 64) && _read_hex(key, out->sig.key, 32);
+	}
+
+	return false;
+}
+
+static void _write_entry(FILE *f, const struct cache_entry *e) {
+	const struct util_file_id *id = &e->id;
+	fprintf(f, "%" PRIu64 " %" PRIu64 " %" PRIu64 " %" PRId64 " %" PRId64 " %" PRId64 " ", id->dev, id->ino, id->size, id->mtime_ns, id->ctime_ns, e->last_used);
+
+	if (e->kind == CACHE_CRC) {
+		fprintf(f, "crc %08" PRIX32 "\n", e->crc);
+	} else {
+		fprintf(f, "sig %s %08" PRIX32 " ", e->sig.valid ? "pass" : "fail", e->sig.sar_sum);
+		_write_hex(f, e->sig.signature, 64);
+		fputc(' ', f);
+		_write_hex(f, e->sig.key, 32);
+		fputc('\n', f);
+	}
+}
+
+// Adds every entry in the file that's recent enough, except ones for files
+// the cache already has something newer for
+static void _cache_read(struct cache *cache, const char *path) {
+	FILE *f = fopen(path, "r");
+	if (!f) return;
+
+	char line[LINE_MAX_LEN];
+	bool current = fgets(line, sizeof line, f) != NULL;
+	if (current) {
+		util_strip_whitespace(line);
+		current = !strcmp(line, CACHE_VERSION);
+	}
+
+	if (!current) {
+		fclose(f);
+		cache->dirty = true;
+		return;
+	}
+
+	while (fgets(line, sizeof line, f)) {
+		struct cache_entry entry;
+		if (!_parse_entry(line, &entry)) {
+			cache->dirty = true;
+			continue;
+		}
+
+		if (entry.last_used + CACHE_MAX_AGE < cache->now) {
+			cache->dirty = true;
+			continue;
+		}
+
+		if (_cache_has(cache, &entry.id)) continue;
+		_cache_add(cache, &entry);
+	}
+
+	fclose(f);
+}
+
+// }}}
+
+struct cache *cache_load(const char *path) {
+	struct cache *cache = calloc(1, sizeof *cache);
+	cache->path = malloc(strlen(path) + 1);
+	strcpy(cache->path, path);
+	cache->now = time(NULL);
+
+	_cache_read(cache, path);
+	return cache;
+}
+
+const struct cache_entry *cache_find(struct cache *cache, const struct util_file_id *id) {
+	if (!cache->nslots) return NULL;
+
+	size_t slot = *_cache_slot(cache, id->dev, id->ino);
+	if (!slot) return NULL;
+
+	struct cache_entry *e = &cache->entries[slot - 1];
+	if (memcmp(&e->id, id, sizeof *id)) return NULL;
+
+	if (e->last_used + CACHE_TOUCH_AGE < cache->now) {
+		e->last_used = cache->now;
+		cache->dirty = true;
+	}
+	return e;
+}
+
+const struct cache_entry *cache_find_key(struct cache *cache, const unsigned char *key) {
+	if (!cache->nkey_slots) return NULL;
+
+	size_t mask = cache->nkey_slots - 1;
+	for (size_t i = _key_start(cache, key); cache->key_slots[i]; i = (i + 1) & mask) {
+		const struct cache_entry *e = &cache->entries[cache->key_slots[i] - 1];
+		if (e->kind == CACHE_SIG && !memcmp(e->sig.key, key, sizeof e->sig.key)) return e;
+	}
+	return NULL;
+}
+
+void cache_put(struct cache *cache, const struct cache_entry *entry) {
+	int64_t mtime = entry->id.mtime_ns / 1000000000;
+	int64_t ctime = entry->id.ctime_ns / 1000000000;
+	if (mtime + CACHE_RACY_AGE >= cache->now || ctime + CACHE_RACY_AGE >= cache->now) return;
+
+	struct cache_entry e = *entry;
+	e.last_used = cache->now;
+	_cache_add(cache, &e);
+	cache->dirty = true;
+}
+
+bool cache_save(struct cache *cache) {
+	if (!cache->dirty) return true;
+
+	// Other runs are kept out from reading the file until we've replaced it,
+	// or they'd write it back without what we add. The file itself is what
+	// gets replaced, so the lock is taken on another one next to it. If even
+	// that can't be had, saving anyway still beats losing everything.
+	char *lock_path = malloc(strlen(cache->path) + 8);
+	sprintf(lock_path, "%s.lock", cache->path);
+	struct util_lock lock;
+	bool locked = util_lock_file(lock_path, &lock);
+	free(lock_path);
+
+	// pick up whatever anyone else saved while we were running
+	_cache_read(cache, cache->path);
+
+	char *tmp_path = malloc(strlen(cache->path) + 32);
+	sprintf(tmp_path, "%s.%lu.tmp", cache->path, util_process_id());
+
+	FILE *f = fopen(tmp_path, "w");
+	if (!f) {
+		if (locked) util_unlock_file(&lock);
+		free(tmp_path);
+		return false;
+	}
+
+	fputs(CACHE_VERSION "\n", f);
+	for (size_t i = 0; i < cache->nentries; ++i) {
+		_write_entry(f, &cache->entries[i]);
+	}
+
+	bool ok = !ferror(f);
+	ok = fclose(f) == 0 && ok;
+	ok = ok && util_replace_file(tmp_path, cache->path);
+	if (!ok) remove(tmp_path);
+	if (locked) util_unlock_file(&lock);
+
+	free(tmp_path);
+	if (ok) cache->dirty = false;
+	return ok;
+}
+
+void cache_free(struct cache *cache) {
+	if (!cache) return;
+	free(cache->path);
+	free(cache->entries);
+	free(cache->slots);
+	free(cache->key_slots);
+	free(cache);
+}
@@ -0,0 +1,49 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "demo.h"
+#include "util.h"
+
+// What checking a demo came to, kept on disk between runs so an unchanged demo
+// doesn't get hashed again. Entries are found by file identity; a v2 verdict
+// can also be found by its demo_sig.key, for a demo that's since been copied
+// or touched and so needs hashing anyway, but not the curve math. A v1
+// checksum can't be found by contents: telling that they're the same means
+// reading all of them, which costs as much as the CRC, and going by a sample
+// instead would let an edit elsewhere in a copy pass on the old checksum.
+struct cache_entry {
+	struct util_file_id id;
+	int64_t last_used; // unix time
+	enum {
+		CACHE_CRC, // v1: the demo checksum
+		CACHE_SIG, // v2: the signature and whether it checked out
+	} kind;
+	union {
+		uint32_t crc;
+		struct demo_sig sig;
+	};
+};
+
+struct cache;
+
+// A missing, unreadable or outdated file just gives an empty cache.
+struct cache *cache_load(const char *path);
+// Only returns an entry whose identity matches id in full.
+const struct cache_entry *cache_find(struct cache *cache, const struct util_file_id *id);
+const struct cache_entry *cache_find_key(struct cache *cache, const unsigned char *key);
+// Replaces whatever was cached for the same file. Files modified in the last
+// couple of seconds aren't cached, since they could change again without
+// their timestamps moving.
+void cache_put(struct cache *cache, const struct cache_entry *entry);
+// Writes the cache back if anything changed, merged with whatever other runs
+// have saved since it was loaded. The file is replaced in one go, so a reader
+// never sees half of it, and runs saving at once take turns (on a lock file
+// alongside it), so none of their new entries are lost. Returns false if it
+// couldn't be written.
+bool cache_save(struct cache *cache);
+void cache_free(struct cache *cache);
+
+#endif
@@ -60,28 +60,217 @@ char **config_read_newline_sep(const char *path) {
 	return lines;
 }
 
-bool config_check_cmd_whitelist(char **cmds, const char *cmd) {
-	if (!cmds) return false;
-	while (*cmds) {
-		if (util_is_prefix_i(*cmds, cmd)) return true;
-		++cmds;
+// Tries {{{
+
+// Built over a sorted list of strings. Node i's children are reached through
+// edges [edges, edges + nedges), sorted by character, and the strings that
+// end exactly at it are [ends, ends + nends) in the list.
+struct _trie_node {
+	uint32_t edges;
+	uint32_t ends;
+	uint32_t nends;
+	uint16_t nedges;
+};
+
+struct _trie {
+	struct _trie_node *nodes;
+	size_t nnodes;
+	uint8_t *edge_chars;
+	uint32_t *edge_nodes;
+	size_t nedges;
+};
+
+// Builds the node for the strings [lo, hi), which all share their first
+// depth characters, and returns its index. The children of a node are given
+// their edges before any of them is built, so they end up contiguous.
+static uint32_t _trie_build_node(struct _trie *trie, const char *const *strs, size_t lo, size_t hi, size_t depth) {
+	uint32_t idx = trie->nnodes++;
+	struct _trie_node node = { .ends = lo };
+
+	// the ones ending here sort first
+	while (lo < hi && strs[lo][depth] == 0) {
+		++node.nends;
+		++lo;
 	}
-	return false;
+
+	node.edges = trie->nedges;
+	for (size_t i = lo; i < hi; ++i) {
+		if (i == lo || strs[i][depth] != strs[i - 1][depth]) ++node.nedges;
+	}
+	trie->nedges += node.nedges;
+
+	uint32_t edge = node.edges;
+	for (size_t i = lo; i < hi;) {
+		size_t j = i + 1;
+		while (j < hi && strs[j][depth] == strs[i][depth]) ++j;
+		trie->edge_chars[edge] = strs[i][depth];
+		trie->edge_nodes[edge] = _trie_build_node(trie, strs, i, j, depth + 1);
+		++edge;
+		i = j;
+	}
+
+	trie->nodes[idx] = node;
+	return idx;
+}
+
+// strs has to be sorted by strcmp
+static void _trie_build(struct _trie *trie, const char *const *strs, size_t n) {
+	// every character adds at most one node and one edge
+	size_t chars = 0;
+	for (size_t i = 0; i < n; ++i) chars += strlen(strs[i]);
+
+	trie->nodes = malloc((chars + 1) * sizeof trie->nodes[0]);
+	trie->nnodes = 0;
+	trie->edge_chars = malloc(chars + 1);
+	trie->edge_nodes = malloc((chars + 1) * sizeof trie->edge_nodes[0]);
+	trie->nedges = 0;
+
+	_trie_build_node(trie, strs, 0, n, 0);
+}
+
+static inline const struct _trie_node *_trie_child(const struct _trie *trie, const struct _trie_node *node, uint8_t c) {
+	const uint8_t *chars = trie->edge_chars + node->edges;
+	for (size_t i = 0; i < node->nedges; ++i) {
+		if (chars[i] == c) return &trie->nodes[trie->edge_nodes[node->edges + i]];
+	}
+	return NULL;
+}
+
+static void _trie_free(struct _trie *trie) {
+	free(trie->nodes);
+	free(trie->edge_chars);
+	free(trie->edge_nodes);
 }
 
-bool config_check_sum_whitelist(char **sums, uint32_t sum) {
-	if (!sums) return false;
-	while (*sums) {
+// }}}
+
+// Command whitelist {{{
+
+struct cmd_whitelist {
+	struct _trie trie;
+};
+
+// Matches tolower in the C locale, which is the only one we run in
+static inline uint8_t _fold(uint8_t c) {
+	return c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c;
+}
+
+static int _cmp_str(const void *a, const void *b) {
+	return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+struct cmd_whitelist *config_compile_cmd_whitelist(char **prefixes) {
+	size_t n = 0;
+	while (prefixes[n]) ++n;
+
+	char **strs = malloc((n + 1) * sizeof strs[0]);
+	for (size_t i = 0; i < n; ++i) {
+		size_t len = strlen(prefixes[i]);
+		strs[i] = malloc(len + 1);
+		for (size_t j = 0; j <= len; ++j) strs[i][j] = _fold(prefixes[i][j]);
+	}
+	qsort(strs, n, sizeof strs[0], _cmp_str);
+
+	struct cmd_whitelist *list = malloc(sizeof *list);
+	_trie_build(&list->trie, (const char *const *)strs, n);
+
+	for (size_t i = 0; i < n; ++i) free(strs[i]);
+	free(strs);
+
+	return list;
+}
+
+struct cmd_whitelist *config_read_cmd_whitelist(const char *path) {
+	char **lines = config_read_newline_sep(path);
+	if (!lines) return NULL;
+
+	struct cmd_whitelist *list = config_compile_cmd_whitelist(lines);
+	config_free_newline_sep(lines);
+	return list;
+}
+
+bool config_check_cmd_whitelist(const struct cmd_whitelist *list, const char *cmd) {
+	if (!list) return false;
+
+	// the first prefix that ends along the way is enough
+	const struct _trie_node *node = &list->trie.nodes[0];
+	while (!node->nends) {
+		uint8_t c = _fold(*cmd++);
+		if (!c) return false;
+		node = _trie_child(&list->trie, node, c);
+		if (!node) return false;
+	}
+	return true;
+}
+
+void config_free_cmd_whitelist(struct cmd_whitelist *list) {
+	if (!list) return;
+	_trie_free(&list->trie);
+	free(list);
+}
+
+// }}}
+
+// SAR checksum whitelist {{{
+
+struct sum_whitelist {
+	uint32_t *sums;
+	size_t nsums;
+};
+
+static int _cmp_sum(const void *a, const void *b) {
+	uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+	return (x > y) - (x < y);
+}
+
+struct sum_whitelist *config_read_sum_whitelist(const char *path) {
+	char **lines = config_read_newline_sep(path);
+	if (!lines) return NULL;
+
+	size_t n = 0;
+	while (lines[n]) ++n;
+
+	struct sum_whitelist *list = malloc(sizeof *list);
+	list->sums = malloc((n + 1) * sizeof list->sums[0]);
+	list->nsums = 0;
+
+	for (size_t i = 0; i < n; ++i) {
 		char *end;
-		uint32_t valid = strtoll(*sums, &end, 16);
-		if (end != *sums && *end == 0) {
-			if (valid == sum) return true;
+		uint32_t sum = strtoll(lines[i], &end, 16);
+		if (end == lines[i] || *end != 0) {
+			fprintf(g_errfile, "%s: ignoring invalid checksum '%s'\n", path, lines[i]);
+			continue;
 		}
-		++sums;
+		list->sums[list->nsums++] = sum;
 	}
-	return false;
+
+	config_free_newline_sep(lines);
+
+	qsort(list->sums, list->nsums, sizeof list->sums[0], _cmp_sum);
+
+	return list;
+}
+
+bool config_check_sum_whitelist(const struct sum_whitelist *list, uint32_t sum) {
+	if (!list) return false;
+
+	size_t lo = 0, hi = list->nsums;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		if (list->sums[mid] < sum) lo = mid + 1;
+		else hi = mid;
+	}
+	return lo < list->nsums && list->sums[lo] == sum;
 }
 
+void config_free_sum_whitelist(struct sum_whitelist *list) {
+	if (!list) return;
+	free(list->sums);
+	free(list);
+}
+
+// }}}
+
 void config_free_newline_sep(char **lines) {
 	if (!lines) return;
 	char **ptr = lines;
@@ -92,7 +281,7 @@ void config_free_newline_sep(char **lines) {
 	free(lines);
 }
 
-struct var_whitelist *config_read_var_whitelist(const char *path) {
+struct config_var *config_read_vars(const char *path) {
 	FILE *f = fopen(path, "r");
 	if (!f) {
 		fprintf(g_errfile, "%s: failed to open file\n", path);
@@ -101,7 +290,7 @@ struct var_whitelist *config_read_var_whitelist(const char *path) {
 
 	size_t entry_alloc = 32;
 	size_t entry_count = 0;
-	struct var_whitelist *list = malloc(entry_alloc * sizeof list[0]);
+	struct config_var *list = malloc(entry_alloc * sizeof list[0]);
 
 	while (1) {
 		char *line = malloc(256); // lines won't reasonably be longer than this
@@ -115,7 +304,7 @@ struct var_whitelist *config_read_var_whitelist(const char *path) {
 			fprintf(g_errfile, "%s: line %zu too long\n", path, entry_count + 1);
 			free(line);
 			for (size_t i = 0; i < entry_count; ++i) {
-				free(list[i].var_name);
+				free(list[i].name);
 			}
 			free(list);
 			return NULL;
@@ -139,7 +328,7 @@ struct var_whitelist *config_read_var_whitelist(const char *path) {
 			while (isspace(*split)) ++split;
 		}
 
-		list[entry_count++] = (struct var_whitelist){ line, *split ? split : NULL };
+		list[entry_count++] = (struct config_var){ line, *split ? split : NULL };
 
 		if (entry_count == entry_alloc) {
 			entry_alloc *= 2;
@@ -147,35 +336,246 @@ struct var_whitelist *config_read_var_whitelist(const char *path) {
 		}
 	}
 
-	list[entry_count] = (struct var_whitelist){ NULL, NULL };
+	list[entry_count] = (struct config_var){ NULL, NULL };
 
 	fclose(f);
 
 	return list;
 }
 
-int config_check_var_whitelist(struct var_whitelist *list, const char *var, const char *val) {
-	if (!list) return false;
+void config_free_vars(struct config_var *list) {
+	if (!list) return;
+	struct config_var *list1 = list;
+	while (list1->name) {
+		free(list1->name);
+		++list1;
+	}
+	free(list);
+}
+
+// Var whitelist {{{
+
+// Names are stored reversed, so a suffix of the name being checked is a
+// prefix in the trie. Entries sort by name, then value, with no value first.
+struct _var_entry {
+	char *rname;
+	char *val; // NULL for any value
+};
+
+struct var_whitelist {
+	struct _trie trie;
+	struct _var_entry *entries;
+	size_t nentries;
+};
+
+static int _cmp_var_entry(const void *a, const void *b) {
+	const struct _var_entry *x = a, *y = b;
+	int c = strcmp(x->rname, y->rname);
+	if (c) return c;
+	if (!x->val || !y->val) return !!x->val - !!y->val;
+	return strcmp(x->val, y->val);
+}
+
+struct var_whitelist *config_compile_var_whitelist(const struct config_var *vars, bool any_val_star) {
+	size_t n = 0;
+	while (vars[n].name) ++n;
+
+	struct var_whitelist *list = malloc(sizeof *list);
+	list->entries = malloc((n + 1) * sizeof list->entries[0]);
+	list->nentries = n;
+
+	for (size_t i = 0; i < n; ++i) {
+		const char *val = vars[i].val;
+		if (any_val_star && val && !strcmp(val, "*")) val = NULL;
+
+		size_t name_len = strlen(vars[i].name);
+		size_t val_len = val ? strlen(val) : 0;
+		char *rname = malloc(name_len + 1 + val_len + 1);
+		for (size_t j = 0; j < name_len; ++j) rname[j] = vars[i].name[name_len - 1 - j];
+		rname[name_len] = 0;
+
+		list->entries[i].rname = rname;
+		list->entries[i].val = NULL;
+		if (val) {
+			list->entries[i].val = rname + name_len + 1;
+			memcpy(list->entries[i].val, val, val_len + 1);
+		}
+	}
+	qsort(list->entries, n, sizeof list->entries[0], _cmp_var_entry);
+
+	const char **names = malloc((n + 1) * sizeof names[0]);
+	for (size_t i = 0; i < n; ++i) names[i] = list->entries[i].rname;
+	_trie_build(&list->trie, names, n);
+	free(names);
+
+	return list;
+}
+
+struct var_whitelist *config_read_var_whitelist(const char *path, bool any_val_star) {
+	struct config_var *vars = config_read_vars(path);
+	if (!vars) return NULL;
+
+	struct var_whitelist *list = config_compile_var_whitelist(vars, any_val_star);
+	config_free_vars(vars);
+	return list;
+}
+
+// Whether any of the entries ending at node allows val
+static bool _var_node_allows(const struct var_whitelist *list, const struct _trie_node *node, const char *val) {
+	const struct _var_entry *entries = list->entries + node->ends;
+	if (!entries[0].val) return true;
+
+	size_t lo = 0, hi = node->nends;
+	while (lo < hi) {
+		size_t mid = lo + (hi - lo) / 2;
+		int c = strcmp(entries[mid].val, val);
+		if (!c) return true;
+		if (c < 0) lo = mid + 1;
+		else hi = mid;
+	}
+	return false;
+}
+
+int config_check_var_whitelist(const struct var_whitelist *list, const char *var, const char *val) {
+	if (!list) return 0;
+
+	const struct _trie_node *root = &list->trie.nodes[0];
+	size_t len = strlen(var);
 	bool found = false;
-	while (list->var_name) {
-		if (strlen(var) >= strlen(list->var_name)) {
-			if (!strcmp("*", list->var_name) || !strcmp(var + strlen(var) - strlen(list->var_name), list->var_name)) {
-				found = true;
-				if (!list->val) return 2; // matching
-				if (!strcmp(list->val, val)) return 2; // matching
-			}
+
+	// a name of * matches any var but an empty one
+	const struct _trie_node *star = len ? _trie_child(&list->trie, root, '*') : NULL;
+	if (star && star->nends) {
+		found = true;
+		if (_var_node_allows(list, star, val)) return 2;
+	}
+
+	// every node passed on the way down is an entry that's a suffix of var
+	const struct _trie_node *node = root;
+	while (len) {
+		node = _trie_child(&list->trie, node, var[--len]);
+		if (!node) break;
+		if (node->nends) {
+			found = true;
+			if (_var_node_allows(list, node, val)) return 2;
 		}
-		++list;
 	}
+
 	return found ? 1 : 0;
 }
 
 void config_free_var_whitelist(struct var_whitelist *list) {
 	if (!list) return;
-	struct var_whitelist *list1 = list;
-	while (list1->var_name) {
-		free(list1->var_name);
-		++list1;
-	}
+	_trie_free(&list->trie);
+	for (size_t i = 0; i < list->nentries; ++i) free(list->entries[i].rname);
+	free(list->entries);
 	free(list);
 }
+
+// }}}
+
+// Expected maps {{{
+
+// open addressing; a slot holds the index into names of a map's first line
+// plus one, or 0 if it's empty. A map listed more than once is found from its
+// first line through next, which holds the index of the next line with the
+// same name plus one, or 0 for the last.
+struct expected_maps {
+	char **names;
+	size_t nnames;
+	size_t *next;
+	size_t *slots;
+	size_t nslots;
+};
+
+static size_t *_map_slot(const struct expected_maps *maps, const char *name) {
+	uint64_t h = UINT64_C(14695981039346656037);
+	for (const char *c = name; *c; ++c) {
+		h ^= (uint8_t)*c;
+		h *= UINT64_C(1099511628211);
+	}
+
+	size_t mask = maps->nslots - 1;
+	for (size_t i = h & mask;; i = (i + 1) & mask) {
+		size_t *slot = &maps->slots[i];
+		if (!*slot || !strcmp(maps->names[*slot - 1], name)) return slot;
+	}
+}
+
+struct expected_maps *config_read_expected_maps(const char *path) {
+	char **lines = config_read_newline_sep(path);
+	if (!lines) return NULL;
+
+	size_t n = 0;
+	while (lines[n]) ++n;
+
+	struct expected_maps *maps = malloc(sizeof *maps);
+	maps->names = lines;
+	maps->nnames = n;
+	maps->next = calloc(n ? n : 1, sizeof maps->next[0]);
+	maps->nslots = 16;
+	while (maps->nslots < n * 2) maps->nslots *= 2;
+	maps->slots = calloc(maps->nslots, sizeof maps->slots[0]);
+
+	// duplicates are kept, so each copy is reported missing like before;
+	// they're chained together behind the first one
+	size_t *last = calloc(n ? n : 1, sizeof last[0]);
+	for (size_t i = 0; i < n; ++i) {
+		size_t *slot = _map_slot(maps, lines[i]);
+		if (!*slot) {
+			*slot = i + 1;
+		} else {
+			maps->next[last[*slot - 1]] = i + 1;
+		}
+		last[*slot - 1] = i;
+	}
+	free(last);
+
+	return maps;
+}
+
+void config_free_expected_maps(struct expected_maps *maps) {
+	if (!maps) return;
+	config_free_newline_sep(maps->names);
+	free(maps->next);
+	free(maps->slots);
+	free(maps);
+}
+
+size_t config_expected_maps_count(const struct expected_maps *maps) {
+	return maps ? maps->nnames : 0;
+}
+
+const char *config_expected_map_name(const struct expected_maps *maps, size_t i) {
+	return maps->names[i];
+}
+
+void config_init_map_found(struct map_found *found, const struct expected_maps *maps) {
+	found->nwords = (config_expected_maps_count(maps) + 63) / 64;
+	found->bits = calloc(found->nwords ? found->nwords : 1, sizeof found->bits[0]);
+}
+
+void config_mark_map_found(const struct expected_maps *maps, struct map_found *found, const char *name) {
+	if (!maps) return;
+	for (size_t i = *_map_slot(maps, name); i; i = maps->next[i - 1]) {
+		found->bits[(i - 1) / 64] |= UINT64_C(1) << (i - 1) % 64;
+	}
+}
+
+bool config_is_map_found(const struct map_found *found, size_t i) {
+	return found->bits[i / 64] >> i % 64 & 1;
+}
+
+void config_merge_map_found(struct map_found *dst, const struct map_found *src) {
+	for (size_t i = 0; i < dst->nwords && i < src->nwords; ++i) {
+		dst->bits[i] |= src->bits[i];
+	}
+}
+
+void config_free_map_found(struct map_found *found) {
+	free(found->bits);
+	found->bits = NULL;
+	found->nwords = 0;
+}
+
+// }}}
@@ -5,18 +5,70 @@
 #include <stdint.h>
 
 char **config_read_newline_sep(const char *path);
-bool config_check_cmd_whitelist(char **cmds, const char *cmd);
-bool config_check_sum_whitelist(char **sums, uint32_t sum);
 void config_free_newline_sep(char **paths);
 
-struct var_whitelist {
-	char *var_name;
+// A line of a name, whitespace and then optionally a value. The list ends
+// with a NULL name.
+struct config_var {
+	char *name;
 	char *val;
 };
 
-struct var_whitelist *config_read_var_whitelist(const char *path);
+struct config_var *config_read_vars(const char *path);
+void config_free_vars(struct config_var *list);
+
+// The command whitelist, compiled into a trie over case-folded prefixes so
+// that checking a command takes time in its length rather than the list's.
+struct cmd_whitelist;
+
+struct cmd_whitelist *config_read_cmd_whitelist(const char *path);
+// Builds the trie from a NULL-terminated list of prefixes, which isn't kept.
+struct cmd_whitelist *config_compile_cmd_whitelist(char **prefixes);
+// Whether any prefix on the list starts cmd, ignoring case
+bool config_check_cmd_whitelist(const struct cmd_whitelist *list, const char *cmd);
+void config_free_cmd_whitelist(struct cmd_whitelist *list);
+
+// The SAR checksum whitelist, parsed up front into a sorted array. Lines that
+// aren't a hex checksum are reported when it's read, then left out.
+struct sum_whitelist;
+
+struct sum_whitelist *config_read_sum_whitelist(const char *path);
+bool config_check_sum_whitelist(const struct sum_whitelist *list, uint32_t sum);
+void config_free_sum_whitelist(struct sum_whitelist *list);
+
+// A list of names, each with a value or none for any value, where an entry
+// matches every var its name is a suffix of and a name of * matches them all.
+// Compiled into a trie over the reversed names, so a check takes time in the
+// var's length. With any_val_star, a value of * means any value too.
+struct var_whitelist;
+
+struct var_whitelist *config_read_var_whitelist(const char *path, bool any_val_star);
+struct var_whitelist *config_compile_var_whitelist(const struct config_var *vars, bool any_val_star);
 // 0: not present, 1: present but not matching, 2: matching
-int config_check_var_whitelist(struct var_whitelist *list, const char *var, const char *val);
+int config_check_var_whitelist(const struct var_whitelist *list, const char *var, const char *val);
 void config_free_var_whitelist(struct var_whitelist *list);
 
+// The maps every demo between them should visit, in a hash set. Which ones
+// have been seen is kept apart in a map_found bitmap, so any number of
+// workers can each keep their own and merge them at the end.
+struct expected_maps;
+
+struct map_found {
+	uint64_t *bits;
+	size_t nwords;
+};
+
+struct expected_maps *config_read_expected_maps(const char *path);
+void config_free_expected_maps(struct expected_maps *maps);
+// The maps in the order they were listed, duplicates included, for reporting
+size_t config_expected_maps_count(const struct expected_maps *maps);
+const char *config_expected_map_name(const struct expected_maps *maps, size_t i);
+
+void config_init_map_found(struct map_found *found, const struct expected_maps *maps);
+void config_mark_map_found(const struct expected_maps *maps, struct map_found *found, const char *name);
+bool config_is_map_found(const struct map_found *found, size_t i);
+// dst gets every map found in either; both must be for the same maps
+void config_merge_map_found(struct map_found *dst, const struct map_found *src);
+void config_free_map_found(struct map_found *found);
+
 #endif
@@ -0,0 +1,236 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "crc32.h"
+#include "crc_table.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CRC32_X86
+#include <immintrin.h>
+#endif
+
+// Slicing-by-16: each step XORs the next 16 bytes against the state and looks
+// every byte up in its own table, so there's no chain of dependent lookups
+// within a step like there is going byte by byte.
+static uint32_t _crc32_slice16(uint32_t crc, const uint8_t *data, size_t len) {
+	const uint32_t (*t)[256] = _g_crc_slice_table;
+
+	while (len >= 16) {
+		crc ^= (uint32_t)data[0] | (uint32_t)data[1] << 8 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 24;
+		crc =
+			t[15][crc & 0xFF] ^ t[14][(crc >> 8) & 0xFF] ^ t[13][(crc >> 16) & 0xFF] ^ t[12][crc >> 24] ^
+			t[11][data[4]] ^ t[10][data[5]] ^ t[9][data[6]] ^ t[8][data[7]] ^
+			t[7][data[8]] ^ t[6][data[9]] ^ t[5][data[10]] ^ t[4][data[11]] ^
+			t[3][data[12]] ^ t[2][data[13]] ^ t[1][data[14]] ^ t[0][data[15]];
+		data += 16;
+		len -= 16;
+	}
+
+	while (len--) {
+		crc = (crc >> 8) ^ t[0][(crc ^ *data++) & 0xFF];
+	}
+
+	return crc;
+}
+
+#ifdef CRC32_X86
+
+// Carry-less multiply folding {{{
+
+#define K128(lo, hi) _mm_set_epi64x(hi, lo)
+#define K(pair) K128(pair)
+
+static bool _has_pclmul(void) {
+	return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse4.1");
+}
+
+static bool _has_vpclmul(void) {
+	return _has_pclmul() && __builtin_cpu_supports("avx512f") && __builtin_cpu_supports("vpclmulqdq");
+}
+
+// The 128-bit helpers are forced inline so that inside _crc32_vpclmul they get
+// VEX encodings too; mixing in legacy SSE after touching the 512-bit registers
+// costs more than the kernel saves.
+__attribute__((target("pclmul,sse4.1"), always_inline))
+static inline __m128i _fold128(__m128i x, __m128i k, __m128i next) {
+	__m128i lo = _mm_clmulepi64_si128(x, k, 0x00);
+	__m128i hi = _mm_clmulepi64_si128(x, k, 0x11);
+	return _mm_xor_si128(_mm_xor_si128(lo, hi), next);
+}
+
+// Folds the remaining whole 16-byte blocks into x, advancing *data and *len
+// past them, then reduces it to the 32-bit CRC state.
+__attribute__((target("pclmul,sse4.1"), always_inline))
+static inline uint32_t _fold_finish(__m128i x, const uint8_t **data, size_t *len) {
+	__m128i k = K(FOLD_128);
+	while (*len >= 16) {
+		x = _fold128(x, k, _mm_loadu_si128((const __m128i *)*data));
+		*data += 16;
+		*len -= 16;
+	}
+
+	// 128 bits down to 64
+	__m128i mask32 = _mm_setr_epi32(~0, 0, ~0, 0);
+	__m128i t = _mm_clmulepi64_si128(x, k, 0x10);
+	x = _mm_xor_si128(_mm_srli_si128(x, 8), t);
+	t = _mm_srli_si128(x, 4);
+	x = _mm_and_si128(x, mask32);
+	x = _mm_clmulepi64_si128(x, _mm_set_epi64x(0, FOLD_64), 0x00);
+	x = _mm_xor_si128(x, t);
+
+	// and 64 down to 32
+	__m128i poly = K128(BARRETT_P, BARRETT_MU);
+	t = _mm_and_si128(x, mask32);
+	t = _mm_clmulepi64_si128(t, poly, 0x10);
+	t = _mm_and_si128(t, mask32);
+	t = _mm_clmulepi64_si128(t, poly, 0x00);
+	x = _mm_xor_si128(x, t);
+
+	return _mm_extract_epi32(x, 1);
+}
+
+// PCLMULQDQ, four 128-bit lanes (64 bytes) at a time
+__attribute__((target("pclmul,sse4.1")))
+static uint32_t _crc32_pclmul(uint32_t crc, const uint8_t *data, size_t len) {
+	if (len < 64) return _crc32_slice16(crc, data, len);
+
+	const __m128i *p = (const __m128i *)data;
+	__m128i x0 = _mm_xor_si128(_mm_loadu_si128(p + 0), _mm_cvtsi32_si128(crc));
+	__m128i x1 = _mm_loadu_si128(p + 1);
+	__m128i x2 = _mm_loadu_si128(p + 2);
+	__m128i x3 = _mm_loadu_si128(p + 3);
+	data += 64;
+	len -= 64;
+
+	__m128i k = K(FOLD_512);
+	while (len >= 64) {
+		p = (const __m128i *)data;
+		x0 = _fold128(x0, k, _mm_loadu_si128(p + 0));
+		x1 = _fold128(x1, k, _mm_loadu_si128(p + 1));
+		x2 = _fold128(x2, k, _mm_loadu_si128(p + 2));
+		x3 = _fold128(x3, k, _mm_loadu_si128(p + 3));
+		data += 64;
+		len -= 64;
+	}
+
+	k = K(FOLD_128);
+	x0 = _fold128(x0, k, x1);
+	x0 = _fold128(x0, k, x2);
+	x0 = _fold128(x0, k, x3);
+
+	crc = _fold_finish(x0, &data, &len);
+	return _crc32_slice16(crc, data, len);
+}
+
+__attribute__((target("avx512f,vpclmulqdq,pclmul,sse4.1"), always_inline))
+static inline __m512i _fold512(__m512i x, __m512i k, __m512i next) {
+	__m512i lo = _mm512_clmulepi64_epi128(x, k, 0x00);
+	__m512i hi = _mm512_clmulepi64_epi128(x, k, 0x11);
+	return _mm512_xor_si512(_mm512_xor_si512(lo, hi), next);
+}
+
+// VPCLMULQDQ, the same thing with 512-bit registers: four of them, so 256 bytes
+// at a time
+__attribute__((target("avx512f,vpclmulqdq,pclmul,sse4.1")))
+static uint32_t _crc32_vpclmul(uint32_t crc, const uint8_t *data, size_t len) {
+	if (len < 256) return _crc32_slice16(crc, data, len);
+
+	const __m512i *p = (const __m512i *)data;
+	__m512i crc_vec = _mm512_inserti32x4(_mm512_setzero_si512(), _mm_cvtsi32_si128(crc), 0);
+	__m512i x0 = _mm512_xor_si512(_mm512_loadu_si512(p + 0), crc_vec);
+	__m512i x1 = _mm512_loadu_si512(p + 1);
+	__m512i x2 = _mm512_loadu_si512(p + 2);
+	__m512i x3 = _mm512_loadu_si512(p + 3);
+	data += 256;
+	len -= 256;
+
+	__m512i k = _mm512_broadcast_i32x4(K(FOLD_2048));
+	while (len >= 256) {
+		p = (const __m512i *)data;
+		x0 = _fold512(x0, k, _mm512_loadu_si512(p + 0));
+		x1 = _fold512(x1, k, _mm512_loadu_si512(p + 1));
+		x2 = _fold512(x2, k, _mm512_loadu_si512(p + 2));
+		x3 = _fold512(x3, k, _mm512_loadu_si512(p + 3));
+		data += 256;
+		len -= 256;
+	}
+
+	k = _mm512_broadcast_i32x4(K(FOLD_512));
+	x0 = _fold512(x0, k, x1);
+	x0 = _fold512(x0, k, x2);
+	x0 = _fold512(x0, k, x3);
+
+	while (len >= 64) {
+		x0 = _fold512(x0, k, _mm512_loadu_si512((const __m512i *)data));
+		data += 64;
+		len -= 64;
+	}
+
+	// fold the four lanes into the last one; each is a different distance away
+	__m512i lanes_k = _mm512_inserti32x4(_mm512_inserti32x4(_mm512_inserti32x4(_mm512_setzero_si512(), K(FOLD_384), 0), K(FOLD_256), 1), K(FOLD_128), 2);
+	__m512i folded = _fold512(x0, lanes_k, _mm512_setzero_si512());
+	__m128i x = _mm512_extracti32x4_epi32(x0, 3);
+	x = _mm_xor_si128(x, _mm512_extracti32x4_epi32(folded, 0));
+	x = _mm_xor_si128(x, _mm512_extracti32x4_epi32(folded, 1));
+	x = _mm_xor_si128(x, _mm512_extracti32x4_epi32(folded, 2));
+
+	// done with the wide registers; leaving their upper halves dirty slows down
+	// any SSE code that runs after us
+	_mm256_zeroupper();
+
+	crc = _fold_finish(x, &data, &len);
+	return _crc32_slice16(crc, data, len);
+}
+
+// }}}
+
+#endif
+
+static bool _always(void) {
+	return true;
+}
+
+const struct crc32_impl g_crc32_impls[] = {
+#ifdef CRC32_X86
+	{ "vpclmul", _crc32_vpclmul, _has_vpclmul },
+	{ "pclmul", _crc32_pclmul, _has_pclmul },
+#endif
+	{ "slice16", _crc32_slice16, _always },
+};
+
+const size_t g_crc32_nimpls = sizeof g_crc32_impls / sizeof g_crc32_impls[0];
+
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len) {
+#ifdef CRC32_X86
+	// the vector kernels only pay off once there's a few blocks to fold, and
+	// the 512-bit one needs a couple of KiB before it beats the 128-bit one
+	if (len >= 2048 && _has_vpclmul()) return _crc32_vpclmul(crc, data, len);
+	if (len >= 64 && _has_pclmul()) return _crc32_pclmul(crc, data, len);
+#endif
+	return _crc32_slice16(crc, data, len);
+}
+
+// Multiplies a and b modulo P, both in the reflected representation
+static uint32_t _multmodp(uint32_t a, uint32_t b) {
+	uint32_t m = (uint32_t)1 << 31;
+	uint32_t p = 0;
+	while (true) {
+		if (a & m) {
+			p ^= b;
+			if ((a & (m - 1)) == 0) break;
+		}
+		m >>= 1;
+		b = b & 1 ? (b >> 1) ^ 0xEDB88320 : b >> 1;
+	}
+	return p;
+}
+
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2) {
+	// crc1 gets multiplied by x^(8*len2), i.e. pushed past len2 zero bytes
+	uint32_t x = (uint32_t)1 << 31;
+	for (unsigned k = 3; len2; len2 >>= 1, ++k) {
+		if (len2 & 1) x = _multmodp(_g_crc_x2n_table[k & 31], x);
+	}
+	return _multmodp(x, crc1) ^ crc2;
+}
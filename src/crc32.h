@@ -0,0 +1,29 @@
+#ifndef CRC32_H
+#define CRC32_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Standard (IEEE) CRC32. crc is the running state: start from 0xFFFFFFFF and
+// invert the result once all the data has gone through.
+// Picks the fastest implementation this CPU supports for the length given.
+uint32_t crc32_update(uint32_t crc, const uint8_t *data, size_t len);
+
+// Given the finished CRCs of two pieces of data, gives the CRC of them joined
+// together, so separate chunks can be hashed independently.
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, size_t len2);
+
+// Every implementation crc32_update chooses between, fastest first, so they
+// can be tested and benchmarked against each other. Only call fn if supported
+// returns true; the last one is portable and always supported.
+struct crc32_impl {
+	const char *name;
+	uint32_t (*fn)(uint32_t crc, const uint8_t *data, size_t len);
+	bool (*supported)(void);
+};
+
+extern const struct crc32_impl g_crc32_impls[];
+extern const size_t g_crc32_nimpls;
+
+#endif
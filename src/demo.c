@@ -1,3 +1,4 @@
+#include <ctype.h>
 #include <math.h>
 #include <stdbool.h>
 #include <stdint.h>
@@ -6,114 +7,34 @@
 #include <string.h>
 
 #include "common.h"
-#include "crc_table.h"
+#include "arena.h"
+#include "crc32.h"
 #include "demo.h"
 #include "util.h"
 #include "ed25519/ed25519.h"
 
 #define HDR_SIZE 1072
 
-static unsigned char _g_demo_sign_pubkey[32] = {
+static const unsigned char _g_demo_sign_pubkey[32] = {
 	0xF5, 0x84, 0x77, 0x86, 0x98, 0x45, 0x91, 0xA8,
 	0x4E, 0x6E, 0x51, 0x1F, 0x34, 0xDF, 0x59, 0x81,
 	0x76, 0x81, 0xF7, 0x0E, 0x95, 0x7B, 0x31, 0xD9,
 	0xD8, 0x0E, 0x79, 0xD0, 0x5F, 0xDB, 0x9B, 0x19,
 };
 
-// Freeing {{{
-
-static inline void _speedrun_summary_free(struct sar_speedrun_summary summary) {
-	for (size_t i = 0; i < summary.nsplits; ++i) {
-		for (size_t j = 0; j < summary.splits[i].nsegs; ++j) {
-			free(summary.splits[i].segs[j].name);
-		}
-		free(summary.splits[i].name);
-		free(summary.splits[i].segs);
-	}
-	for (size_t i = 0; i < summary.nrules; ++i) {
-		free(summary.rules[i].name);
-		free(summary.rules[i].data);
-	}
-	free(summary.splits);
-	free(summary.rules);
-}
-
-static inline void _sar_data_free(struct sar_data data) {
-	switch (data.type) {
-	case SAR_DATA_INITIAL_CVAR:
-		free(data.initial_cvar.cvar);
-		free(data.initial_cvar.val);
-		break;
-
-	case SAR_DATA_ENTITY_INPUT_SLOT:
-	case SAR_DATA_ENTITY_INPUT:
-		free(data.entity_input.targetname);
-		free(data.entity_input.classname);
-		free(data.entity_input.inputname);
-		free(data.entity_input.parameter);
-		break;
-
-	case SAR_DATA_WAIT_RUN:
-		free(data.wait_run.cmd);
-		break;
-
-	case SAR_DATA_HWAIT_RUN:
-		free(data.hwait_run.cmd);
-		break;
-
-	case SAR_DATA_SPEEDRUN_TIME:
-		_speedrun_summary_free(data.speedrun_time);
-		break;
-
-	case SAR_DATA_SPEEDRUN_TIME_INCOMPLETE:
-		_speedrun_summary_free(data.speedrun_time_incomplete);
-		break;
+// Every v2 demo is checked against the same key, so it's decompressed (and its
+// multiples tabulated) just once, by demo_init
+static ed25519_fixed_key *_g_demo_sign_key;
 
-	case SAR_DATA_FILE_CHECKSUM:
-		free(data.file_checksum.path);
-		break;
+// Setup {{{
 
-	case SAR_DATA_VPK_CHECKSUM:
-		free(data.vpk_checksum.path);
-		for (size_t i = 0; i < data.vpk_checksum.nentries; ++i) {
-			free(data.vpk_checksum.entries[i].path);
-		}
-		free(data.vpk_checksum.entries);
-		break;
-
-	default:
-		break;
-	}
+void demo_init(void) {
+	_g_demo_sign_key = ed25519_fixed_key_create(_g_demo_sign_pubkey);
 }
 
-static inline void _msg_free(struct demo_msg *msg) {
-	switch (msg->type) {
-	case DEMO_MSG_CONSOLE_CMD:
-		free(msg->con_cmd);
-		break;
-
-	case DEMO_MSG_SAR_DATA:
-		_sar_data_free(msg->sar_data);
-		break;
-
-	default:
-		break;
-	}
-
-	free(msg);
-}
-
-void demo_free(struct demo *demo) {
-	if (!demo) return;
-	free(demo->hdr.server_name);
-	free(demo->hdr.client_name);
-	free(demo->hdr.map_name);
-	free(demo->hdr.game_directory);
-	for (size_t i = 0; i < demo->nmsgs; ++i) {
-		_msg_free(demo->msgs[i]);
-	}
-	free(demo->msgs);
-	free(demo);
+void demo_shutdown(void) {
+	ed25519_fixed_key_free(_g_demo_sign_key);
+	_g_demo_sign_key = NULL;
 }
 
 // }}}
@@ -125,7 +46,7 @@ static inline uint32_t _read_u32(const uint8_t *buf) {
 		(buf[0] << 0) |
 		(buf[1] << 8) |
 		(buf[2] << 16) |
-		(buf[3] << 24);
+		((uint32_t)buf[3] << 24);
 }
 
 static inline float _read_f32(const uint8_t *buf) {
@@ -134,44 +55,80 @@ static inline float _read_f32(const uint8_t *buf) {
 	return u.f;
 }
 
-static int _parse_speedrun_summary(struct sar_speedrun_summary *out, uint8_t *data, size_t len) {
-	uint8_t *data_orig = data;
-	uint8_t *data_end = data + len;
+// Reads a NUL-terminated string starting at str, returning the number of
+// bytes it occupies (including the terminator). If it is terminated before
+// end, *out points straight into the mapping; otherwise the remaining bytes
+// are copied into the arena and the whole range up to end is consumed. With
+// no arena, unterminated strings just come out empty.
+static size_t _read_str(struct arena *arena, const char **out, const uint8_t *str, const uint8_t *end) {
+	if (str >= end) {
+		*out = "";
+		return 0;
+	}
+
+	const uint8_t *nul = memchr(str, 0, end - str);
+	if (nul) {
+		*out = (const char *)str;
+		return nul - str + 1;
+	}
+
+	*out = arena ? arena_strndup(arena, str, end - str) : "";
+	return end - str;
+}
+
+// With out == NULL this only checks the summary is well-formed, without
+// allocating anything.
+static int _parse_speedrun_summary(struct arena *arena, struct sar_speedrun_summary *out, const uint8_t *data, size_t len) {
+	const uint8_t *data_orig = data;
+	const uint8_t *data_end = data + len;
 	int ret = 1;
 
-	memset(out, 0, sizeof *out);
+	if (out) memset(out, 0, sizeof *out);
 
 	if (len < 4) goto done;
 
-	out->nsplits = _read_u32(data);
+	size_t nsplits = _read_u32(data);
 	data += 4;
 
-	out->splits = calloc(out->nsplits, sizeof out->splits[0]);
-	for (size_t i = 0; i < out->nsplits; ++i) {
+	// every split takes at least 5 bytes; don't let a bogus count make us
+	// allocate gigabytes
+	if (nsplits > (size_t)(data_end - data) / 5) goto done;
+
+	if (out) {
+		out->nsplits = nsplits;
+		out->splits = arena_calloc(arena, nsplits, sizeof out->splits[0]);
+	}
+	for (size_t i = 0; i < nsplits; ++i) {
+		struct sar_speedrun_split *split = out ? &out->splits[i] : NULL;
+		const char *name;
+
 		if (data >= data_end) goto done;
-		out->splits[i].name = strdup((char *)data);
-		data += strlen(out->splits[i].name) + 1;
+		data += _read_str(arena, &name, data, data_end);
 
 		if (data + 4 > data_end) goto done;
-		out->splits[i].nsegs = _read_u32(data);
+		size_t nsegs = _read_u32(data);
 		data += 4;
 
-		out->splits[i].segs = calloc(out->splits[i].nsegs, sizeof out->splits[i].segs[0]);
-		for (size_t j = 0; j < out->splits[i].nsegs; ++j) {
+		if (nsegs > (size_t)(data_end - data) / 5) goto done;
+
+		if (split) {
+			split->name = name;
+			split->nsegs = nsegs;
+			split->segs = arena_calloc(arena, nsegs, sizeof split->segs[0]);
+		}
+		for (size_t j = 0; j < nsegs; ++j) {
 			if (data >= data_end) goto done;
-			out->splits[i].segs[j].name = strdup((char *)data);
-			data += strlen(out->splits[i].segs[j].name) + 1;
+			data += _read_str(arena, &name, data, data_end);
 
 			if (data + 4 > data_end) goto done;
-			out->splits[i].segs[j].ticks = _read_u32(data);
+			if (split) {
+				split->segs[j].name = name;
+				split->segs[j].ticks = _read_u32(data);
+			}
 			data += 4;
 		}
 	}
 
-	if (data > data_end) {
-		goto done;
-	}
-
 	if (data == data_end) {
 		ret = 0;
 		goto done;
@@ -183,18 +140,28 @@ static int _parse_speedrun_summary(struct sar_speedrun_summary *out, uint8_t *da
 	switch (rule_ver) {
 	case 1:
 		if (data + 4 > data_end) goto done;
-		out->nrules = _read_u32(data);
+		size_t nrules = _read_u32(data);
 		data += 4;
 
-		out->rules = calloc(out->nrules, sizeof out->rules[0]);
-		for (size_t i = 0; i < out->nrules; ++i) {
+		if (nrules > (size_t)(data_end - data) / 2) goto done;
+
+		if (out) {
+			out->nrules = nrules;
+			out->rules = arena_calloc(arena, nrules, sizeof out->rules[0]);
+		}
+		for (size_t i = 0; i < nrules; ++i) {
+			const char *name, *rule_data;
+
 			if (data >= data_end) goto done;
-			out->rules[i].name = strdup((char *)data);
-			data += strlen(out->rules[i].name) + 1;
+			data += _read_str(arena, &name, data, data_end);
 
 			if (data >= data_end) goto done;
-			out->rules[i].data = strdup((char *)data);
-			data += strlen(out->rules[i].data) + 1;
+			data += _read_str(arena, &rule_data, data, data_end);
+
+			if (out) {
+				out->rules[i].name = name;
+				out->rules[i].data = rule_data;
+			}
 		}
 		break;
 	default:
@@ -210,79 +177,183 @@ static int _parse_speedrun_summary(struct sar_speedrun_summary *out, uint8_t *da
 	ret = 0;
 
 done:
-	if (ret != 0) {
-		_speedrun_summary_free(*out);
+	if (ret != 0 && out) {
 		memset(out, 0, sizeof *out);
 	}
 	return ret;
 }
 
-// }}}
+// Same deal as _parse_speedrun_summary: out may be NULL to just validate.
+static int _parse_vpk_checksum(struct arena *arena, struct sar_vpk_checksum *out, const uint8_t *data, size_t len) {
+	const uint8_t *data_orig = data;
+	const uint8_t *data_end = data + len;
 
-// _parse_sar_data {{{
+	if (out) memset(out, 0, sizeof *out);
 
-static int _parse_sar_data(struct sar_data *out, FILE *f, size_t len) {
-	if (len == 0) {
-		fprintf(g_errfile, "[SAR] Empty message\n");
-		out->type = SAR_DATA_INVALID;
-		return 0;
+	uint32_t sum = _read_u32(data);
+	data += 4;
+
+	const char *path;
+	data += _read_str(arena, &path, data, data_end);
+	if (data + 4 > data_end) {
+		fprintf(g_errfile, "[SAR] Invalid VPK checksum message length %zu\n", len + 1);
+		return 1;
 	}
 
-	uint8_t type;
-	if (fread(&type, 1, 1, f) != 1) {
+	size_t nentries = _read_u32(data);
+	data += 4;
+
+	// every entry takes at least 5 bytes
+	if (nentries > (size_t)(data_end - data) / 5) {
+		fprintf(g_errfile, "[SAR] VPK checksum data length mismatch %zu %zu\n", data - data_orig, len);
 		return 1;
 	}
 
-	// workaround for bug in initial 1.12 release
-	if (type == SAR_DATA_CHECKSUM && len == 5) {
-		len = 9;
+	struct sar_vpk_checksum_entry *entries = out ? arena_calloc(arena, nentries, sizeof entries[0]) : NULL;
+	for (size_t i = 0; i < nentries; ++i) {
+		if (data + 4 > data_end) {
+			fprintf(g_errfile, "[SAR] VPK checksum data length mismatch %zu %zu\n", data - data_orig, len);
+			return 1;
+		}
+		uint32_t entry_sum = _read_u32(data);
+		data += 4;
+
+		const char *entry_path;
+		data += _read_str(arena, &entry_path, data, data_end);
+
+		if (entries) {
+			entries[i].sum = entry_sum;
+			entries[i].path = entry_path;
+		}
 	}
 
-	uint8_t *data = malloc(len - 1);
-	if (fread(data, 1, len - 1, f) != len - 1) {
+	if (data != data_end) {
+		fprintf(g_errfile, "[SAR] VPK checksum data length mismatch %zu %zu\n", data - data_orig, len);
 		return 1;
 	}
 
-	uint8_t *data_orig = data; // for freeing later, in case data is mutated
+	if (out) {
+		out->sum = sum;
+		out->path = path;
+		out->nentries = nentries;
+		out->entries = entries;
+	}
+
+	return 0;
+}
+
+// }}}
+
+// Reader {{{
+
+// Walks a demo file mapping front to back. Every read is bounds-checked
+// against the mapping, so a truncated demo simply fails to parse its last
+// message rather than running off the end.
+struct _reader {
+	struct arena *arena;
+	const uint8_t *data;
+	size_t size;
+	size_t pos;
+};
+
+static inline size_t _reader_left(const struct _reader *r) {
+	return r->size - r->pos;
+}
+
+static inline const uint8_t *_reader_take(struct _reader *r, size_t n) {
+	if (n > _reader_left(r)) return NULL;
+	const uint8_t *ptr = r->data + r->pos;
+	r->pos += n;
+	return ptr;
+}
+
+// }}}
+
+// Filtering {{{
+
+static inline bool _filter_msg(const struct demo_filter *filter, int type) {
+	return !filter || (filter->msg_types & (UINT32_C(1) << type));
+}
+
+static inline bool _filter_sar(const struct demo_filter *filter, int type) {
+	return !filter || (_filter_msg(filter, DEMO_MSG_SAR_DATA) && (filter->sar_types[type / 64] & (UINT64_C(1) << (type % 64))));
+}
+
+static inline bool _filter_keeps(const struct demo_filter *filter, const struct demo_msg *msg) {
+	if (msg->type == DEMO_MSG_SAR_DATA) return _filter_sar(filter, msg->sar.type);
+	return _filter_msg(filter, msg->type);
+}
+
+// }}}
 
-	out->type = type;
+// _parse_sar_data {{{
+
+// The extent of a single message on disk. Every message is walked this far,
+// but only the payloads of ConsoleCmd and SAR data ever get decoded.
+struct _msg_frame {
+	uint8_t type;
+	uint32_t tick;
+	uint8_t slot;
+
+	// ConsoleCmd string, or SAR data following the type byte
+	const uint8_t *payload;
+	size_t len; // for SAR data, this includes the type byte
+	uint8_t sar_type;
+};
 
-	switch (out->type) {
+// Checks a SAR payload and, if out is given, decodes it too. Validation is
+// what reports errors, so it's done for every message as it's parsed; decoding
+// a payload that already passed can't print anything, so it can happen later
+// whenever someone actually asks for the fields. len includes the type byte,
+// which data points past. Returns the type, or SAR_DATA_INVALID.
+static int _parse_sar_data(struct sar_data *out, struct arena *arena, int type, const uint8_t *data, size_t len) {
+	if (len == 0) {
+		fprintf(g_errfile, "[SAR] Empty message\n");
+		type = SAR_DATA_INVALID;
+		if (out) out->type = type;
+		return type;
+	}
+
+	const uint8_t *data_end = data + len - 1;
+
+	switch (type) {
 	case SAR_DATA_TIMESCALE_CHEAT:
 		if (len != 5) {
 			fprintf(g_errfile, "[SAR] Invalid timescale cheat message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->timescale = _read_f32(data);
 		break;
 
 	case SAR_DATA_INITIAL_CVAR:
-		out->initial_cvar.cvar = strdup((char *)data);
-		out->initial_cvar.val = strdup((char *)data + strlen((const char *)data) + 1);
+		if (!out) break;
+		data += _read_str(arena, &out->initial_cvar.cvar, data, data_end);
+		_read_str(arena, &out->initial_cvar.val, data, data_end);
 		break;
 
 	case SAR_DATA_ENTITY_INPUT_SLOT:
+		if (!out) break;
 		out->slot = data[0];
 		++data;
 	case SAR_DATA_ENTITY_INPUT:
-		out->entity_input.targetname = strdup((char *)data);
-		size_t targetname_len = strlen(out->entity_input.targetname);
-		out->entity_input.classname = strdup((char *)data + targetname_len + 1);
-		size_t classname_len = strlen(out->entity_input.classname);
-		out->entity_input.inputname = strdup((char *)data + targetname_len + classname_len + 2);
-		size_t inputname_len = strlen(out->entity_input.inputname);
-		out->entity_input.parameter = strdup((char *)data + targetname_len + classname_len + inputname_len + 3);
+		if (!out) break;
+		data += _read_str(arena, &out->entity_input.targetname, data, data_end);
+		data += _read_str(arena, &out->entity_input.classname, data, data_end);
+		data += _read_str(arena, &out->entity_input.inputname, data, data_end);
+		_read_str(arena, &out->entity_input.parameter, data, data_end);
 		break;
 
 	case SAR_DATA_CHECKSUM:
 		if (len != 9) {
 			fprintf(g_errfile, "[SAR] Invalid checksum message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->checksum.demo_sum = _read_u32(data);
 		out->checksum.sar_sum = _read_u32(data + 4);
 
@@ -291,10 +362,11 @@ static int _parse_sar_data(struct sar_data *out, FILE *f, size_t len) {
 	case SAR_DATA_CHECKSUM_V2:
 		if (len != 69) {
 			fprintf(g_errfile, "[SAR] Invalid checksum v2 message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->checksum_v2.sar_sum = _read_u32(data);
 		memcpy(out->checksum_v2.signature, data + 4, 64);
 
@@ -303,10 +375,11 @@ static int _parse_sar_data(struct sar_data *out, FILE *f, size_t len) {
 	case SAR_DATA_PORTAL_PLACEMENT:
 		if (len != 15) {
 			fprintf(g_errfile, "[SAR] Invalid portal placement message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->slot = data[0];
 		out->portal_placement.orange = data[1];
 		out->portal_placement.x = _read_f32(data + 2);
@@ -319,20 +392,22 @@ static int _parse_sar_data(struct sar_data *out, FILE *f, size_t len) {
 	case SAR_DATA_CROUCH_FLY:
 		if (len != 2) {
 			fprintf(g_errfile, "[SAR] Invalid challenge flags message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->slot = data[0];
 		break;
 
 	case SAR_DATA_PAUSE:
 		if (len < 5 || len > 6) {
 			fprintf(g_errfile, "[SAR] Invalid pause message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->pause_time.ticks = _read_u32(data);
 		out->pause_time.timed = len == 6 ? data[4] : -1;
 		break;
@@ -340,34 +415,37 @@ static int _parse_sar_data(struct sar_data *out, FILE *f, size_t len) {
 	case SAR_DATA_WAIT_RUN:
 		if (len < 6) {
 			fprintf(g_errfile, "[SAR] Invalid wait run message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->wait_run.tick = _read_u32(data);
-		out->wait_run.cmd = strdup((char *)data + 4);
+		_read_str(arena, &out->wait_run.cmd, data + 4, data_end);
 
 		break;
 
 	case SAR_DATA_HWAIT_RUN:
 		if (len < 6) {
 			fprintf(g_errfile, "[SAR] Invalid hwait run message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->hwait_run.ticks = _read_u32(data);
-		out->hwait_run.cmd = strdup((char *)data + 4);
+		_read_str(arena, &out->hwait_run.cmd, data + 4, data_end);
 
 		break;
 
 	case SAR_DATA_ENTITY_SERIAL:
 		if (len != 9) {
 			fprintf(g_errfile, "[SAR] Invalid entity serial message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->entity_serial.slot = _read_f32(data);
 		out->entity_serial.serial = _read_f32(data);
 
@@ -376,10 +454,11 @@ static int _parse_sar_data(struct sar_data *out, FILE *f, size_t len) {
 	case SAR_DATA_FRAMETIME:
 		if (len != 5) {
 			fprintf(g_errfile, "[SAR] Invalid frametime message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->frametime = _read_f32(data);
 
 		break;
@@ -387,22 +466,23 @@ static int _parse_sar_data(struct sar_data *out, FILE *f, size_t len) {
 	case SAR_DATA_SPEEDRUN_TIME:
 		if (len < 5) {
 			fprintf(g_errfile, "[SAR] Invalid speedrun time message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
-		if (_parse_speedrun_summary(&out->speedrun_time, data, len - 1)) {
-			out->type = SAR_DATA_INVALID;
+		if (_parse_speedrun_summary(arena, out ? &out->speedrun_time : NULL, data, len - 1)) {
+			type = SAR_DATA_INVALID;
 		}
 		break;
 
 	case SAR_DATA_TIMESTAMP:
 		if (len != 8) {
 			fprintf(g_errfile, "[SAR] Invalid timestamp message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->timestamp.year = data[0] | (data[1] << 8);
 		out->timestamp.mon = data[2] + 1; // month off-by-one lol
 		out->timestamp.day = data[3];
@@ -415,136 +495,120 @@ static int _parse_sar_data(struct sar_data *out, FILE *f, size_t len) {
 	case SAR_DATA_FILE_CHECKSUM:
 		if (len < 6) {
 			fprintf(g_errfile, "[SAR] Invalid file checksum message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		out->file_checksum.sum = _read_u32(data);
-		out->file_checksum.path = strdup((char *)(data + 4));
+		_read_str(arena, &out->file_checksum.path, data + 4, data_end);
 
 		break;
 
 	case SAR_DATA_QUEUEDCMD:
-		out->queuedcmd = strdup((char *)data);
+		if (!out) break;
+		_read_str(arena, &out->queuedcmd, data, data_end);
 		
 		break;
 
 	case SAR_DATA_VPK_CHECKSUM:
 		if (len < 10) {
 			fprintf(g_errfile, "[SAR] Invalid VPK checksum message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
-		out->vpk_checksum.sum = _read_u32(data);
-		data += 4;
-
-		out->vpk_checksum.path = strdup((char *)data);
-		data += strlen(out->vpk_checksum.path) + 1;
-		if (data + 4 > data_orig + len - 1) {
-			fprintf(g_errfile, "[SAR] Invalid VPK checksum message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
-			break;
-		}
-
-		out->vpk_checksum.nentries = _read_u32(data);
-		data += 4;
-
-		out->vpk_checksum.entries = calloc(out->vpk_checksum.nentries, sizeof out->vpk_checksum.entries[0]);
-		for (size_t i = 0; i < out->vpk_checksum.nentries; ++i) {
-			if (data + 4 > data_orig + len - 1) {
-				fprintf(g_errfile, "[SAR] VPK checksum data length mismatch %zu %zu\n", data - data_orig, len - 1);
-				out->type = SAR_DATA_INVALID;
-				break;
-			}
-			out->vpk_checksum.entries[i].sum = _read_u32(data);
-			data += 4;
-
-			out->vpk_checksum.entries[i].path = strdup((char *)data);
-			data += strlen(out->vpk_checksum.entries[i].path) + 1;
-		}
-
-		if (out->type != SAR_DATA_INVALID && data != data_orig + len - 1) {
-			fprintf(g_errfile, "[SAR] VPK checksum data length mismatch %zu %zu\n", data - data_orig, len - 1);
-			out->type = SAR_DATA_INVALID;
-		}
-		if (out->type == SAR_DATA_INVALID) {
-			free(out->vpk_checksum.path);
-			for (size_t i = 0; i < out->vpk_checksum.nentries; ++i) {
-				free(out->vpk_checksum.entries[i].path);
-			}
-			free(out->vpk_checksum.entries);
-			memset(&out->vpk_checksum, 0, sizeof out->vpk_checksum);
+		if (_parse_vpk_checksum(arena, out ? &out->vpk_checksum : NULL, data, len - 1)) {
+			type = SAR_DATA_INVALID;
 		}
 		break;
 
 	case SAR_DATA_SPEEDRUN_TIME_INCOMPLETE:
 		if (len < 5) {
 			fprintf(g_errfile, "[SAR] Invalid incomplete speedrun time message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
-		if (_parse_speedrun_summary(&out->speedrun_time_incomplete, data, len - 1)) {
-			out->type = SAR_DATA_INVALID;
+		if (_parse_speedrun_summary(arena, out ? &out->speedrun_time_incomplete : NULL, data, len - 1)) {
+			type = SAR_DATA_INVALID;
 		}
 		break;
 
 	case SAR_DATA_SPEEDRUN_ID:
 		if (len != 17) {
 			fprintf(g_errfile, "[SAR] Invalid speedrun identifier message length %zu\n", len);
-			out->type = SAR_DATA_INVALID;
+			type = SAR_DATA_INVALID;
 			break;
 		}
 
+		if (!out) break;
 		memcpy(out->speedrun_id, data, 16);
 		break;
 
 	default:
-		fprintf(g_errfile, "[SAR] Unhandled message type %02X\n", out->type);
-		out->type = SAR_DATA_INVALID;
+		fprintf(g_errfile, "[SAR] Unhandled message type %02X\n", type);
+		type = SAR_DATA_INVALID;
 		break;
 	}
 
-	free(data_orig);
-	return 0;
+	if (out) out->type = type;
+	return type;
 }
 
 // }}}
 
-// _parse_msg {{{
+// _frame_msg {{{
 
-static struct demo_msg *_parse_msg(FILE *f) {
-	uint8_t msg_hdr_buf[6];
-	if (fread(msg_hdr_buf, 1, sizeof msg_hdr_buf, f) != sizeof msg_hdr_buf) {
-		return NULL;
+// Console commands get the same treatment util_strip_whitespace would give
+// them, but we only copy if there's trailing whitespace to cut off or the
+// string isn't terminated inside the message.
+static const char *_parse_con_cmd(struct arena *arena, const uint8_t *str, size_t len) {
+	const uint8_t *nul = memchr(str, 0, len);
+	const uint8_t *end = nul ? nul : str + len;
+
+	while (str < end && isspace(*str)) ++str;
+
+	const uint8_t *trimmed = end;
+	while (trimmed > str && isspace(trimmed[-1])) --trimmed;
+
+	if (nul && trimmed == end) return (const char *)str;
+	return arena_strndup(arena, str, trimmed - str);
+}
+
+// Walks over one message without decoding anything, so it has no side effects
+// beyond advancing the reader. Returns 1 if the message is malformed.
+static int _frame_msg(struct _reader *r, struct _msg_frame *f) {
+	const uint8_t *msg_hdr_buf = _reader_take(r, 6);
+	if (!msg_hdr_buf) {
+		return 1;
 	}
 
 #define READ_U32(x) \
 	uint32_t x; \
 	do { \
-		uint8_t _u32_buf[4]; \
-		if (fread(_u32_buf, 1, sizeof _u32_buf, f) != sizeof _u32_buf) { \
-			free(msg); \
-			return NULL; \
+		const uint8_t *_u32_buf = _reader_take(r, 4); \
+		if (!_u32_buf) { \
+			return 1; \
 		} \
 		x = _read_u32(_u32_buf); \
 	} while (0)
 
 #define SKIP_BYTES(n) \
 	do { \
-		if (fseek(f, (n), SEEK_CUR) == -1) { \
-			free(msg); \
-			return NULL; \
+		if (!_reader_take(r, (n))) { \
+			return 1; \
 		} \
 	} while (0)
 
-	struct demo_msg *msg = malloc(sizeof *msg);
-	msg->type = msg_hdr_buf[0];
-	msg->tick = _read_u32(msg_hdr_buf + 1);
-	msg->slot = msg_hdr_buf[5];
+	f->type = msg_hdr_buf[0];
+	f->tick = _read_u32(msg_hdr_buf + 1);
+	f->slot = msg_hdr_buf[5];
+	f->payload = NULL;
+	f->len = 0;
+	f->sar_type = SAR_DATA_INVALID;
 
-	switch (msg->type) {
+	switch (f->type) {
 	case DEMO_MSG_SIGN_ON:
 	case DEMO_MSG_PACKET: {
 		// skip PacketInfo, InSequence, OutSequence
@@ -556,28 +620,25 @@ static struct demo_msg *_parse_msg(FILE *f) {
 		// skip data
 		SKIP_BYTES(size);
 
-		return msg;
+		return 0;
 	}
 
 	case DEMO_MSG_SYNC_TICK:
 		// no data
-		return msg;
+		return 0;
 
 	case DEMO_MSG_CONSOLE_CMD: {
 		// read size
 		READ_U32(size);
 
 		// read string
-		msg->con_cmd = malloc(size + 1);
-		if (!fgets(msg->con_cmd, size + 1, f) || feof(f)) {
-			free(msg->con_cmd);
-			free(msg);
-			return NULL;
+		f->payload = _reader_take(r, size);
+		if (!f->payload) {
+			return 1;
 		}
+		f->len = size;
 
-		util_strip_whitespace(msg->con_cmd);
-
-		return msg;
+		return 0;
 	}
 
 	case DEMO_MSG_USER_CMD: {
@@ -590,7 +651,7 @@ static struct demo_msg *_parse_msg(FILE *f) {
 		// skip data
 		SKIP_BYTES(size);
 
-		return msg;
+		return 0;
 	}
 
 	case DEMO_MSG_DATA_TABLES: {
@@ -600,12 +661,12 @@ static struct demo_msg *_parse_msg(FILE *f) {
 		// skip data
 		SKIP_BYTES(size);
 
-		return msg;
+		return 0;
 	}
 
 	case DEMO_MSG_STOP:
 		// no data
-		return msg;
+		return 0;
 
 	case DEMO_MSG_CUSTOM_DATA: {
 		// read type and size
@@ -615,22 +676,39 @@ static struct demo_msg *_parse_msg(FILE *f) {
 		if (type != 0 || size == 8) {
 			// not SAR data
 			SKIP_BYTES(size);
-			return msg;
+			return 0;
 		}
 
 		// SAR data!
-		msg->type = DEMO_MSG_SAR_DATA;
+		f->type = DEMO_MSG_SAR_DATA;
 
 		// the first 8 bytes we ignore
 		SKIP_BYTES(8);
 
-		// now, parse SAR data!
-		if (_parse_sar_data(&msg->sar_data, f, size - 8)) {
-			free(msg);
-			return NULL;
+		// an empty message is bad SAR data, but not a broken demo
+		size_t len = size - 8;
+		if (len == 0) {
+			return 0;
+		}
+
+		const uint8_t *sar_type = _reader_take(r, 1);
+		if (!sar_type) {
+			return 1;
+		}
+
+		// workaround for bug in initial 1.12 release
+		if (*sar_type == SAR_DATA_CHECKSUM && len == 5) {
+			len = 9;
+		}
+
+		f->payload = _reader_take(r, len - 1);
+		if (!f->payload) {
+			return 1;
 		}
+		f->len = len;
+		f->sar_type = *sar_type;
 
-		return msg;
+		return 0;
 	}
 
 	case DEMO_MSG_STRING_TABLES: {
@@ -640,12 +718,11 @@ static struct demo_msg *_parse_msg(FILE *f) {
 		// skip data
 		SKIP_BYTES(size);
 
-		return msg;
+		return 0;
 	}
 
 	default:
-		free(msg);
-		return NULL;
+		return 1;
 	}
 
 #undef READ_U32
@@ -654,178 +731,670 @@ static struct demo_msg *_parse_msg(FILE *f) {
 
 // }}}
 
-// _demo_checksum {{{
+// Message store {{{
 
-static uint32_t _demo_checksum(FILE *f) {
-	if (fseek(f, -31, SEEK_END)) return 0; // ignore checksum message
+struct _msg_store {
+	size_t msg_alloc;
+	size_t payload_alloc;
+};
 
-	size_t size = ftell(f);
-	if (size == -1) return 0;
+static void _msg_store_push(struct demo *demo, struct _msg_store *store, const struct _msg_frame *f) {
+	struct arena *arena = demo->arena;
+
+	if (demo->nmsgs == store->msg_alloc) {
+		size_t old = store->msg_alloc;
+		size_t alloc = old ? old * 2 : 4096;
+
+		// all four columns share one allocation
+		uint8_t *buf = arena_alloc(arena, alloc * (sizeof demo->msg_ticks[0] + sizeof demo->msg_payloads[0] + sizeof demo->msg_types[0] + sizeof demo->msg_slots[0]));
+		uint32_t *ticks = (uint32_t *)buf;
+		uint32_t *payloads = ticks + alloc;
+		uint8_t *types = (uint8_t *)(payloads + alloc);
+		uint8_t *slots = types + alloc;
+
+		if (old) {
+			memcpy(ticks, demo->msg_ticks, old * sizeof ticks[0]);
+			memcpy(payloads, demo->msg_payloads, old * sizeof payloads[0]);
+			memcpy(types, demo->msg_types, old * sizeof types[0]);
+			memcpy(slots, demo->msg_slots, old * sizeof slots[0]);
+		}
 
-	if (fseek(f, 0, SEEK_SET)) return 0;
+		demo->msg_ticks = ticks;
+		demo->msg_payloads = payloads;
+		demo->msg_types = types;
+		demo->msg_slots = slots;
+		store->msg_alloc = alloc;
+	}
 
-	uint32_t crc = 0xFFFFFFFF;
+	size_t i = demo->nmsgs++;
+	demo->msg_ticks[i] = f->tick;
+	demo->msg_types[i] = f->type;
+	demo->msg_slots[i] = f->slot;
 
-	for (size_t i = 0; i < size; ++i) {
-		uint8_t byte = fgetc(f);
+	if (f->type != DEMO_MSG_CONSOLE_CMD && f->type != DEMO_MSG_SAR_DATA) {
+		demo->msg_payloads[i] = DEMO_NO_PAYLOAD;
+		return;
+	}
 
-		uint8_t lookup_idx = (crc ^ byte) & 0xFF;
-		crc = (crc >> 8) ^ g_crc_table[lookup_idx];
+	if (demo->npayloads == store->payload_alloc) {
+		size_t old = store->payload_alloc;
+		size_t alloc = old ? old * 2 : 256;
+		demo->payloads = arena_realloc(arena, demo->payloads, old * sizeof demo->payloads[0], alloc * sizeof demo->payloads[0]);
+		store->payload_alloc = alloc;
 	}
 
-	return ~crc;
+	demo->msg_payloads[i] = demo->npayloads;
+	demo->payloads[demo->npayloads++] = (struct demo_payload){
+		.data = f->payload,
+		.len = f->len,
+		.sar_type = f->sar_type,
+	};
+}
+
+// Fills in message i from the columns, decoding a kept ConsoleCmd into arena.
+// SAR data is only validated; see demo_decode_sar.
+static void _msg_store_get(const struct demo *demo, size_t i, struct demo_msg *msg, const struct demo_filter *filter, struct arena *arena) {
+	msg->type = demo->msg_types[i];
+	msg->tick = demo->msg_ticks[i];
+	msg->slot = demo->msg_slots[i];
+
+	if (demo->msg_payloads[i] == DEMO_NO_PAYLOAD) return;
+	const struct demo_payload *payload = &demo->payloads[demo->msg_payloads[i]];
+
+	if (msg->type == DEMO_MSG_CONSOLE_CMD) {
+		if (_filter_msg(filter, DEMO_MSG_CONSOLE_CMD)) msg->con_cmd = _parse_con_cmd(arena, payload->data, payload->len);
+	} else {
+		msg->sar.type = _parse_sar_data(NULL, NULL, payload->sar_type, payload->data, payload->len);
+		msg->sar.data = payload->data;
+		msg->sar.len = payload->len;
+	}
 }
 
 // }}}
 
-// _demo_verify_sig {{{
+// _demo_checksum {{{
 
-static bool _demo_verify_sig(FILE *f, uint32_t sar_sum, const unsigned char *signature) {
-	if (fseek(f, -91, SEEK_END)) return false; // ignore checksum message
+// The trailing SAR checksum messages always have the same size on disk, and
+// the data they cover is everything before them.
+#define V1SUM_MSG_SIZE 31
+#define V2SUM_MSG_SIZE 91
 
-	size_t size = ftell(f);
-	if (size == -1) return false;
+static uint32_t _demo_checksum(const uint8_t *data, size_t size) {
+	if (size < V1SUM_MSG_SIZE) return 0;
+	return ~crc32_update(0xFFFFFFFF, data, size - V1SUM_MSG_SIZE); // ignore checksum message
+}
 
-	if (fseek(f, 0, SEEK_SET)) return false;
+// Checks whether the demo ends in a SAR checksum message of the given type,
+// without parsing anything before it.
+static bool _has_trailing_sum(const uint8_t *data, size_t size, uint8_t sar_type, size_t msg_size) {
+	if (size < HDR_SIZE + msg_size) return false;
+	const uint8_t *msg = data + size - msg_size;
+	return
+		msg[0] == DEMO_MSG_CUSTOM_DATA &&
+		_read_u32(msg + 6) == 0 && // SAR custom data type
+		msg[22] == sar_type;
+}
 
-	char *buf = malloc(size + 4); // extra space for sar checksum
-	fread(buf, 1, size, f);
-	if (ferror(f)) {
-		free(buf);
-		return false;
+// Checksums are computed as part of the message loop: after each message, the
+// bytes it covered are fed into the running state while they're still hot,
+// rather than walking the whole demo again once parsing is done.
+struct _demo_hash {
+	bool crc_enabled;
+	uint32_t crc;
+	size_t crc_end;
+
+	// the signed data is prefixed with R, which we can only take from the
+	// trailer because the whole demo is mapped
+	bool sig_enabled;
+	ed25519_verify_context sig;
+	size_t sig_end;
+
+	size_t pos;
+
+	// set once _demo_hash_start_background has handed the work to threads
+	bool background;
+	size_t ncrc_jobs;
+	struct _crc_job *crc_jobs;
+	bool sig_job_running;
+	struct _sig_job *sig_job;
+};
+
+static void _demo_hash_init(struct _demo_hash *h, const uint8_t *data, size_t size) {
+	memset(h, 0, sizeof *h);
+
+	// only bother if the demo looks like it's going to need it
+	if (_has_trailing_sum(data, size, SAR_DATA_CHECKSUM, V1SUM_MSG_SIZE)) {
+		h->crc_enabled = true;
+		h->crc = 0xFFFFFFFF;
+		h->crc_end = size - V1SUM_MSG_SIZE;
+	}
+
+	if (_has_trailing_sum(data, size, SAR_DATA_CHECKSUM_V2, V2SUM_MSG_SIZE)) {
+		h->sig_enabled = true;
+		h->sig_end = size - V2SUM_MSG_SIZE;
+		ed25519_verify_init_fixed(&h->sig, data + size - V2SUM_MSG_SIZE + 27, _g_demo_sign_key);
+	}
+}
+
+static void _demo_hash_feed(struct _demo_hash *h, const uint8_t *data, size_t end) {
+	if (h->background) {
+		h->pos = end;
+		return;
+	}
+
+	if (h->crc_enabled && h->pos < h->crc_end) {
+		size_t crc_to = end < h->crc_end ? end : h->crc_end;
+		h->crc = crc32_update(h->crc, data + h->pos, crc_to - h->pos);
+	}
+	if (h->sig_enabled && h->pos < h->sig_end) {
+		size_t sig_to = end < h->sig_end ? end : h->sig_end;
+		ed25519_verify_update(&h->sig, data + h->pos, sig_to - h->pos);
 	}
+	h->pos = end;
+}
+
+// }}}
 
-	// write sar checksum to end
-	*(uint32_t *)(buf + size) = sar_sum;
+// Background hashing {{{
 
-	bool res = ed25519_verify(signature, (unsigned char *)buf, size + 4, _g_demo_sign_pubkey);
+// For a really big demo, the hashing can be split off from parsing instead:
+// the CRC in chunks on as many threads as we're given, joined back up with
+// crc32_combine, and the signature hash (which can't be split) on one more.
+// They only need the mapping, so they run alongside the message loop.
 
-	free(buf);
+#define CRC_JOB_MIN_SIZE (4 << 20)
 
-	return res;
+struct _crc_job {
+	struct util_thread thread;
+	bool running;
+	const uint8_t *data;
+	size_t len;
+	uint32_t crc;
+};
+
+struct _sig_job {
+	struct util_thread thread;
+	ed25519_verify_context *ctx;
+	const uint8_t *data;
+	size_t len;
+};
+
+static void _crc_job_run(void *arg) {
+	struct _crc_job *job = arg;
+	job->crc = ~crc32_update(0xFFFFFFFF, job->data, job->len);
+}
+
+static void _sig_job_run(void *arg) {
+	struct _sig_job *job = arg;
+	ed25519_verify_update(job->ctx, job->data, job->len);
+}
+
+static void _demo_hash_start_background(struct _demo_hash *h, struct arena *arena, const uint8_t *data, unsigned nthreads) {
+	if (h->background || h->pos > 0) return;
+	if (!h->crc_enabled && !h->sig_enabled) return;
+
+	h->background = true;
+
+	if (h->crc_enabled) {
+		size_t njobs = h->crc_end / CRC_JOB_MIN_SIZE;
+		if (njobs > nthreads) njobs = nthreads;
+		if (njobs < 1) njobs = 1;
+
+		h->ncrc_jobs = njobs;
+		h->crc_jobs = arena_calloc(arena, njobs, sizeof h->crc_jobs[0]);
+
+		size_t chunk = h->crc_end / njobs;
+		for (size_t i = 0; i < njobs; ++i) {
+			struct _crc_job *job = &h->crc_jobs[i];
+			job->data = data + i * chunk;
+			job->len = i == njobs - 1 ? h->crc_end - i * chunk : chunk;
+			job->running = util_thread_start(&job->thread, _crc_job_run, job);
+			if (!job->running) _crc_job_run(job);
+		}
+	}
+
+	if (h->sig_enabled) {
+		struct _sig_job *job = arena_calloc(arena, 1, sizeof *job);
+		job->ctx = &h->sig;
+		job->data = data;
+		job->len = h->sig_end;
+		h->sig_job = job;
+		h->sig_job_running = util_thread_start(&job->thread, _sig_job_run, job);
+		if (!h->sig_job_running) _sig_job_run(job);
+	}
+}
+
+// Waits for any background hashing to finish, leaving the state as if every
+// byte had been fed in order. Safe to call more than once.
+static void _demo_hash_wait(struct _demo_hash *h) {
+	if (!h->background) return;
+
+	if (h->crc_jobs) {
+		uint32_t crc = 0;
+		for (size_t i = 0; i < h->ncrc_jobs; ++i) {
+			struct _crc_job *job = &h->crc_jobs[i];
+			if (job->running) util_thread_join(&job->thread);
+			job->running = false;
+			crc = i == 0 ? job->crc : crc32_combine(crc, job->crc, job->len);
+		}
+		h->crc = ~crc;
+		h->crc_jobs = NULL;
+	}
+
+	if (h->sig_job_running) {
+		util_thread_join(&h->sig_job->thread);
+		h->sig_job_running = false;
+	}
 }
 
 // }}}
 
-// demo_parse {{{
+// _demo_verify_sig {{{
 
-struct demo *demo_parse(const char *path) {
-	FILE *f = fopen(path, "rb");
-	if (!f) {
-		fprintf(g_errfile, "%s: failed to open file\n", path);
-		return NULL;
+static void _demo_sig_feed_sum(ed25519_verify_context *ctx, uint32_t sar_sum) {
+	// the SAR checksum is signed along with the demo, appended to the end
+	const unsigned char sar_sum_buf[4] = {
+		sar_sum >> 0,
+		sar_sum >> 8,
+		sar_sum >> 16,
+		sar_sum >> 24,
+	};
+	ed25519_verify_update(ctx, sar_sum_buf, sizeof sar_sum_buf);
+}
+
+static bool _demo_verify_sig_finish(ed25519_verify_context *ctx, uint32_t sar_sum) {
+	_demo_sig_feed_sum(ctx, sar_sum);
+	return ed25519_verify_final(ctx);
+}
+
+static bool _demo_verify_sig(const uint8_t *data, size_t size, uint32_t sar_sum, const unsigned char *signature) {
+	if (size < V2SUM_MSG_SIZE) return false;
+
+	ed25519_verify_context ctx;
+	ed25519_verify_init_fixed(&ctx, signature, _g_demo_sign_key);
+	ed25519_verify_update(&ctx, data, size - V2SUM_MSG_SIZE); // ignore checksum message
+
+	return _demo_verify_sig_finish(&ctx, sar_sum);
+}
+
+// The hash the signature is checked against already covers R, the key, the
+// demo and the SAR checksum; hashed again along with the rest of the
+// signature, that's everything the verdict depends on.
+static void _demo_sig_key(const ed25519_verify_context *ctx, unsigned char *key) {
+	sha512_context h = ctx->hash;
+	unsigned char digest[64];
+	sha512_final(&h, digest);
+
+	sha512_init(&h);
+	sha512_update(&h, digest, sizeof digest);
+	sha512_update(&h, ctx->signature, sizeof ctx->signature);
+	sha512_final(&h, digest);
+	memcpy(key, digest, 32);
+}
+
+size_t demo_sig_prepare(const struct util_mapping *maps, size_t n, struct demo_sig *sigs, ed25519_verify_context *ctxs, size_t *which) {
+	const unsigned char **msgs = calloc(n, sizeof msgs[0]);
+	size_t *lens = calloc(n, sizeof lens[0]);
+	size_t nsigned = 0;
+
+	for (size_t i = 0; i < n; ++i) {
+		const struct util_mapping *map = &maps[i];
+		if (!_has_trailing_sum(map->data, map->size, SAR_DATA_CHECKSUM_V2, V2SUM_MSG_SIZE)) continue;
+
+		// the same fields _parse_sar_data would pull out of the trailer
+		const uint8_t *trailer = map->data + map->size - V2SUM_MSG_SIZE;
+		struct demo_sig *sig = &sigs[nsigned];
+		sig->sar_sum = _read_u32(trailer + 23);
+		memcpy(sig->signature, trailer + 27, 64);
+		sig->valid = false;
+
+		ed25519_verify_init_fixed(&ctxs[nsigned], sig->signature, _g_demo_sign_key);
+		msgs[nsigned] = map->data;
+		lens[nsigned] = map->size - V2SUM_MSG_SIZE;
+		which[nsigned] = i;
+		++nsigned;
 	}
 
-	// Header {{{
+	ed25519_verify_update_multi(ctxs, msgs, lens, nsigned);
 
-	uint8_t *hdr_buf = malloc(HDR_SIZE);
+	for (size_t k = 0; k < nsigned; ++k) {
+		_demo_sig_feed_sum(&ctxs[k], sigs[k].sar_sum);
+		_demo_sig_key(&ctxs[k], sigs[k].key);
+	}
 
-	if (fread(hdr_buf, 1, HDR_SIZE, f) != HDR_SIZE) {
+	free(msgs);
+	free(lens);
+
+	return nsigned;
+}
+
+// }}}
+
+// Header {{{
+
+// hdr_buf is the first HDR_SIZE bytes of the demo, or NULL if it's shorter.
+// Strings in the header point into hdr_buf.
+static int _parse_hdr(const char *path, struct arena *arena, const uint8_t *hdr_buf, struct demo_hdr *out) {
+	if (!hdr_buf) {
 		fprintf(g_errfile, "%s: incomplete header\n", path);
-		free(hdr_buf);
-		fclose(f);
-		return NULL;
+		return 1;
 	}
 
 	// check DemoFileStamp
-	if (strncmp((char *)hdr_buf, "HL2DEMO\0", 8)) {
+	if (memcmp(hdr_buf, "HL2DEMO\0", 8)) {
 		fprintf(g_errfile, "%s: invalid header\n", path);
-		free(hdr_buf);
-		fclose(f);
-		return NULL;
+		return 1;
 	}
 
 	// check DemoProtocol
 	if (_read_u32(hdr_buf + 8) != 4) {
 		fprintf(g_errfile, "%s: unsupported protocol version\n", path);
-		free(hdr_buf);
-		fclose(f);
-		return NULL;
+		return 1;
 	}
 
-	struct demo_hdr hdr = {
-		.server_name = strdup((char *)(hdr_buf + 16)),
-		.client_name = strdup((char *)(hdr_buf + 276)),
-		.map_name = strdup((char *)(hdr_buf + 536)),
-		.game_directory = strdup((char *)(hdr_buf + 796)),
+	*out = (struct demo_hdr){
 		.playback_time = fabsf(_read_f32(hdr_buf + 1056)),
 		.playback_ticks = abs((int32_t)_read_u32(hdr_buf + 1060)),
 		.playback_frames = _read_u32(hdr_buf + 1064),
 		.sign_on_length = _read_u32(hdr_buf + 1068),
 	};
 
-	free(hdr_buf);
+	_read_str(arena, &out->server_name, hdr_buf + 16, hdr_buf + 276);
+	_read_str(arena, &out->client_name, hdr_buf + 276, hdr_buf + 536);
+	_read_str(arena, &out->map_name, hdr_buf + 536, hdr_buf + 796);
+	_read_str(arena, &out->game_directory, hdr_buf + 796, hdr_buf + 1056);
+
+	return 0;
+}
+
+int demo_read_header(const char *path, struct arena *arena, struct demo_hdr *out) {
+	FILE *f = fopen(path, "rb");
+	if (!f) {
+		fprintf(g_errfile, "%s: failed to open file\n", path);
+		return 1;
+	}
+
+	// the strings are sliced out of this, so it has to stick around
+	uint8_t *hdr_buf = arena_alloc(arena, HDR_SIZE);
+	size_t n = fread(hdr_buf, 1, HDR_SIZE, f);
+	fclose(f);
 
-	// }}}
+	return _parse_hdr(path, arena, n == HDR_SIZE ? hdr_buf : NULL, out);
+}
 
-	// Messages {{{
+// }}}
 
-	size_t msg_alloc = 512;
-	size_t msg_count = 0;
-	struct demo_msg **msgs = malloc(msg_alloc * sizeof msgs[0]);
+// Iteration {{{
+
+struct demo_iter {
+	const char *path;
+	struct _reader r;
+	bool has_filter;
+	struct demo_filter filter;
+	struct _demo_hash hash;
+
+	// each message is decoded here, and thrown away by the next step
+	struct arena scratch;
+
+	size_t next; // index of the message demo_next looks at next
+	bool done;
+	// where the message that broke the demo starts, and how far it got
+	size_t bad_start, bad_end;
+	bool last_is_sum;
+	struct demo_msg last_sum;
+
+	// from demo_use_sig and demo_use_checksum
+	bool has_presig;
+	struct demo_sig presig;
+	bool has_prechecksum;
+	uint32_t prechecksum;
+};
 
-	while (1) {
-		int c = fgetc(f);
-		if (c == EOF) break;
-		ungetc(c, f);
+static struct demo *_demo_alloc(struct arena *arena) {
+	bool owns_arena = !arena;
+	if (owns_arena) {
+		arena = malloc(sizeof *arena);
+		arena_init(arena);
+	}
 
-		long p = ftell(f);
+	struct demo *demo = arena_calloc(arena, 1, sizeof *demo);
+	demo->arena = arena;
+	demo->owns_arena = owns_arena;
+	return demo;
+}
 
-		struct demo_msg *msg = _parse_msg(f);
-		if (!msg) {
-			fprintf(g_errfile, "%s: malformed demo message at offset %ld %ld\n", path, ftell(f), p);
-			fputs("THE FOLLOWING DEMO IS CORRUPTED. PARSING AS MUCH AS POSSIBLE\n", g_outfile);
-			/*
-			for (size_t i = 0; i < msg_count; ++i) {
-				_msg_free(msgs[i]);
-			}
-			free(msgs);
-			fclose(f);
-			return NULL;*/
+static struct demo *_demo_open(struct demo *demo, const char *path, const struct demo_filter *filter) {
+	struct arena *arena = demo->arena;
+
+	struct _reader r = {
+		.arena = arena,
+		.data = demo->file.data,
+		.size = demo->file.size,
+		.pos = 0,
+	};
+
+	struct demo_hdr hdr;
+	if (_parse_hdr(path, arena, _reader_take(&r, HDR_SIZE), &hdr)) {
+		demo_free(demo);
+		return NULL;
+	}
+
+	struct demo_iter *it = arena_calloc(arena, 1, sizeof *it);
+	it->path = arena_strndup(arena, path, strlen(path));
+	it->r = r;
+
+	// The framing alone is enough to fill in the message columns and to say
+	// whether the demo breaks off somewhere, and with it all mapped that's
+	// cheap to walk, so callers know before they print anything
+	struct _msg_store store = { 0 };
+	struct _reader scan = r;
+	while (_reader_left(&scan) > 0) {
+		size_t p = scan.pos;
+		struct _msg_frame f;
+		if (_frame_msg(&scan, &f)) {
+			demo->corrupted = true;
+			it->bad_start = p;
+			it->bad_end = scan.pos;
 			break;
 		}
+		_msg_store_push(demo, &store, &f);
+	}
+	it->has_filter = filter != NULL;
+	if (filter) it->filter = *filter;
+	_demo_hash_init(&it->hash, r.data, r.size);
+	arena_init(&it->scratch);
+
+	demo->iter = it;
+	demo->hdr = hdr;
+	demo->tickrate = (float)hdr.playback_ticks / hdr.playback_time;
+	demo->trailing_sum.type = SAR_DATA_INVALID;
+
+	return demo;
+}
+
+struct demo *demo_open(const char *path, struct arena *arena, const struct demo_filter *filter) {
+	struct demo *demo = _demo_alloc(arena);
+
+	if (!util_map_file(path, &demo->file)) {
+		fprintf(g_errfile, "%s: failed to open file\n", path);
+		demo_free(demo);
+		return NULL;
+	}
+	demo->owns_file = true;
+
+	return _demo_open(demo, path, filter);
+}
+
+struct demo *demo_open_mapping(const char *path, const struct util_mapping *map, struct arena *arena, const struct demo_filter *filter) {
+	struct demo *demo = _demo_alloc(arena);
+
+	demo->file = *map;
+	demo->owns_file = true;
 
-		if (msg_count == msg_alloc) {
-			msg_alloc *= 2;
-			msgs = realloc(msgs, msg_alloc * sizeof msgs[0]);
+	return _demo_open(demo, path, filter);
+}
+
+struct demo *demo_open_buffer(const char *name, const void *data, size_t size, struct arena *arena, const struct demo_filter *filter) {
+	struct demo *demo = _demo_alloc(arena);
+
+	demo->file.data = data;
+	demo->file.size = size;
+	demo->owns_file = false;
+
+	return _demo_open(demo, name, filter);
+}
+
+// Decodes the next message into msg, allocating from arena. Unlike demo_next,
+// this also returns messages the filter doesn't keep.
+static bool _demo_step(struct demo *demo, struct demo_msg *msg, struct arena *arena) {
+	struct demo_iter *it = demo->iter;
+	if (it->done) return false;
+	if (it->next == demo->nmsgs) {
+		if (demo->corrupted) {
+			fprintf(g_errfile, "%s: malformed demo message at offset %zu %zu\n", it->path, it->bad_end, it->bad_start);
 		}
+		it->done = true;
+		return false;
+	}
 
-		msgs[msg_count++] = msg;
+	const struct demo_filter *filter = it->has_filter ? &it->filter : NULL;
+	size_t i = it->next++;
+	_msg_store_get(demo, i, msg, filter, arena);
+
+	// remember a checksum message in case it's the last one
+	it->last_is_sum = msg->type == DEMO_MSG_SAR_DATA && (msg->sar.type == SAR_DATA_CHECKSUM || msg->sar.type == SAR_DATA_CHECKSUM_V2);
+	if (it->last_is_sum) {
+		it->last_sum = *msg;
 	}
 
-	// }}}
+	// hash up to the end of any payload we've just looked at while it's hot;
+	// nothing else is read between here and demo_close
+	if (demo->msg_payloads[i] != DEMO_NO_PAYLOAD) {
+		const struct demo_payload *payload = &demo->payloads[demo->msg_payloads[i]];
+		if (payload->data) {
+			const uint8_t *end = payload->data + payload->len - (msg->type == DEMO_MSG_SAR_DATA);
+			_demo_hash_feed(&it->hash, it->r.data, end - it->r.data);
+		}
+	}
+
+	return true;
+}
+
+void demo_use_sig(struct demo *demo, const struct demo_sig *sig) {
+	struct demo_iter *it = demo->iter;
+	if (!it || it->hash.pos > 0 || it->hash.background) return;
+
+	it->has_presig = true;
+	it->presig = *sig;
+	it->hash.sig_enabled = false;
+}
+
+void demo_use_checksum(struct demo *demo, uint32_t checksum) {
+	struct demo_iter *it = demo->iter;
+	if (!it || it->hash.pos > 0 || it->hash.background) return;
+
+	it->has_prechecksum = true;
+	it->prechecksum = checksum;
+	it->hash.crc_enabled = false;
+}
+
+void demo_hash_in_background(struct demo *demo, unsigned nthreads) {
+	if (!demo->iter) return;
+	_demo_hash_start_background(&demo->iter->hash, demo->arena, demo->file.data, nthreads);
+}
 
-	// Checksum {{{
+bool demo_next(struct demo *demo, struct demo_msg *msg) {
+	struct demo_iter *it = demo->iter;
+	if (!it) return false;
+
+	const struct demo_filter *filter = it->has_filter ? &it->filter : NULL;
+
+	do {
+		arena_reset(&it->scratch);
+		if (!_demo_step(demo, msg, &it->scratch)) return false;
+	} while (!_filter_keeps(filter, msg));
+
+	return true;
+}
+
+void demo_close(struct demo *demo) {
+	struct demo_iter *it = demo->iter;
+	if (!it) return;
+
+	// drain whatever the caller didn't get to, so the checksums cover it
+	struct demo_msg msg;
+	while (demo_next(demo, &msg));
+
+	const struct _reader *r = &it->r;
+	struct _demo_hash *hash = &it->hash;
+	_demo_hash_wait(hash);
 
 	uint32_t checksum = 0;
 	bool v2sum_present = false;
 	bool v2sum_valid = false;
 
-	if (msg_count > 0) {
-		struct demo_msg *last = msgs[msg_count - 1];
-		if (last->type == DEMO_MSG_SAR_DATA && last->sar_data.type == SAR_DATA_CHECKSUM) {
-			// There's a SAR checksum message - calculate the demo checksum
-			checksum = _demo_checksum(f);
-		} else if (last->type == DEMO_MSG_SAR_DATA && last->sar_data.type == SAR_DATA_CHECKSUM_V2) {
+	if (it->last_is_sum) {
+		struct sar_data *sum = &demo->trailing_sum;
+		demo_decode_sar(demo, &it->last_sum, sum);
+		if (sum->type == SAR_DATA_CHECKSUM) {
+			// There's a SAR checksum message - finish the demo checksum
+			if (it->has_prechecksum) {
+				checksum = it->prechecksum;
+			} else if (hash->crc_enabled) {
+				_demo_hash_feed(hash, r->data, r->size);
+				checksum = ~hash->crc;
+			} else {
+				checksum = _demo_checksum(r->data, r->size);
+			}
+		} else {
 			// v2 checksum - extract SAR checksum and verify signature
 			v2sum_present = true;
-			v2sum_valid = _demo_verify_sig(f, last->sar_data.checksum_v2.sar_sum, last->sar_data.checksum_v2.signature);
+			if (it->has_presig && it->presig.sar_sum == sum->checksum_v2.sar_sum && !memcmp(it->presig.signature, sum->checksum_v2.signature, 64)) {
+				v2sum_valid = it->presig.valid;
+			} else if (hash->sig_enabled && !memcmp(hash->sig.signature, sum->checksum_v2.signature, 64)) {
+				_demo_hash_feed(hash, r->data, r->size);
+				v2sum_valid = _demo_verify_sig_finish(&hash->sig, sum->checksum_v2.sar_sum);
+			} else {
+				v2sum_valid = _demo_verify_sig(r->data, r->size, sum->checksum_v2.sar_sum, sum->checksum_v2.signature);
+			}
 		}
 	}
 
-	// }}}
-
-	fclose(f);
-
-	struct demo *demo = malloc(sizeof *demo);
-	demo->hdr = hdr;
-	demo->nmsgs = msg_count;
-	demo->msgs = msgs;
 	demo->checksum = checksum;
 	demo->v2sum_state = v2sum_present ? (v2sum_valid ? V2SUM_VALID : V2SUM_INVALID) : V2SUM_NONE;
-	demo->tickrate = (float)hdr.playback_ticks / hdr.playback_time;
 
-	return demo;
+	arena_destroy(&it->scratch);
+	demo->iter = NULL;
+}
+
+void demo_decode_sar(struct demo *demo, const struct demo_msg *msg, struct sar_data *out) {
+	if (msg->sar.type == SAR_DATA_INVALID) {
+		out->type = SAR_DATA_INVALID;
+		return;
+	}
+
+	struct arena *arena = demo->iter ? &demo->iter->scratch : demo->arena;
+	_parse_sar_data(out, arena, msg->sar.type, msg->sar.data, msg->sar.len);
+}
+
+// }}}
+
+// Freeing {{{
+
+void demo_free(struct demo *demo) {
+	if (!demo) return;
+	if (demo->iter) {
+		// nothing can still be reading the mapping once it's gone
+		_demo_hash_wait(&demo->iter->hash);
+		arena_destroy(&demo->iter->scratch);
+	}
+	if (demo->owns_file) util_unmap_file(&demo->file);
+	if (demo->owns_arena) {
+		// the demo itself lives in the arena, so don't touch it after this
+		struct arena *arena = demo->arena;
+		arena_destroy(arena);
+		free(arena);
+	}
 }
 
 // }}}
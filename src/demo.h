@@ -5,11 +5,14 @@
 #include <stdbool.h>
 #include <stdint.h>
 
+#include "util.h"
+#include "ed25519/ed25519.h"
+
 struct demo_hdr {
-	char *server_name;
-	char *client_name;
-	char *map_name;
-	char *game_directory;
+	const char *server_name;
+	const char *client_name;
+	const char *map_name;
+	const char *game_directory;
 	float playback_time;
 	uint32_t playback_ticks;
 	uint32_t playback_frames;
@@ -19,26 +22,26 @@ struct demo_hdr {
 struct sar_speedrun_summary {
 	size_t nsplits;
 	struct sar_speedrun_split {
-		char *name;
+		const char *name;
 		size_t nsegs;
 		struct sar_speedrun_seg {
-			char *name;
+			const char *name;
 			int ticks;
 		} *segs;
 	} *splits;
 	size_t nrules;
 	struct sar_speedrun_rule {
-		char *name;
-		char *data;
+		const char *name;
+		const char *data;
 	} *rules;
 };
 
 struct sar_vpk_checksum {
-	char *path;
+	const char *path;
 	uint32_t sum;
 	size_t nentries;
 	struct sar_vpk_checksum_entry {
-		char *path;
+		const char *path;
 		uint32_t sum;
 	} *entries;
 };
@@ -75,7 +78,7 @@ struct sar_data {
 	union {
 		float timescale;
 		float frametime;
-		char *queuedcmd;
+		const char *queuedcmd;
 
 		struct {
 			uint32_t ticks;
@@ -83,8 +86,8 @@ struct sar_data {
 		} pause_time;
 
 		struct {
-			char *cvar;
-			char *val;
+			const char *cvar;
+			const char *val;
 		} initial_cvar;
 
 		struct {
@@ -98,10 +101,10 @@ struct sar_data {
 		} checksum_v2;
 
 		struct {
-			char *targetname;
-			char *classname;
-			char *inputname;
-			char *parameter;
+			const char *targetname;
+			const char *classname;
+			const char *inputname;
+			const char *parameter;
 		} entity_input;
 
 		struct {
@@ -111,12 +114,12 @@ struct sar_data {
 
 		struct {
 			int tick;
-			char *cmd;
+			const char *cmd;
 		} wait_run;
 
 		struct {
 			int ticks;
-			char *cmd;
+			const char *cmd;
 		} hwait_run;
 
 		struct {
@@ -137,7 +140,7 @@ struct sar_data {
 		} timestamp;
 
 		struct {
-			char *path;
+			const char *path;
 			uint32_t sum;
 		} file_checksum;
 
@@ -167,19 +170,79 @@ struct demo_msg {
 
 	union {
 		// ConsoleCmd
-		char *con_cmd;
+		const char *con_cmd;
 
-		// SAR data
-		struct sar_data sar_data;
+		// SAR data, already validated but still encoded; demo_decode_sar
+		// gets at the fields
+		struct {
+			int type; // SAR_DATA_INVALID if it didn't validate
+			const uint8_t *data;
+			size_t len;
+		} sar;
 	};
 };
 
+struct arena;
+struct demo_iter;
+
+#define DEMO_NO_PAYLOAD UINT32_MAX
+
+// Where the payload of a ConsoleCmd or SAR data message sits in the demo
+struct demo_payload {
+	const uint8_t *data;
+	size_t len; // for SAR data, this includes the type byte, which data points past
+	uint8_t sar_type;
+};
+
+// Selects which messages demo_next returns. Anything not selected is skipped
+// without being decoded, though SAR data is still checked for corruption
+// either way.
+struct demo_filter {
+	uint32_t msg_types; // bit n keeps DEMO_MSG_* type n
+	uint64_t sar_types[4]; // bit n keeps SAR_DATA_* type n, if DEMO_MSG_SAR_DATA is kept
+};
+
+static inline void demo_filter_add_msg(struct demo_filter *filter, int type) {
+	filter->msg_types |= UINT32_C(1) << type;
+}
+
+static inline void demo_filter_add_sar(struct demo_filter *filter, int type) {
+	filter->sar_types[type / 64] |= UINT64_C(1) << (type % 64);
+}
+
+// All strings in a demo point into its file mapping (or the buffer it was
+// opened from) wherever the data is already NUL-terminated; only the odd
+// malformed or whitespace-padded string gets its own copy. The demo itself
+// lives in the arena passed to demo_open, and so do any strings copied for the
+// header.
 struct demo {
+	struct util_mapping file;
+	bool owns_file; // false if file is a caller's buffer rather than a mapping
+	struct arena *arena;
+	bool owns_arena;
+	struct demo_iter *iter; // non-NULL between demo_open and demo_close
 	struct demo_hdr hdr;
+	// Every message up to any corruption, stored column-wise by demo_open:
+	// msg_ticks, msg_types and msg_slots have one entry per message, so
+	// scanning for a type touches a single byte each. Only ConsoleCmd and SAR
+	// data messages carry anything else; msg_payloads holds the index of their
+	// entry in payloads, and DEMO_NO_PAYLOAD for the rest. demo_next walks
+	// these rather than the file.
 	size_t nmsgs;
-	struct demo_msg **msgs;
+	uint32_t *msg_ticks;
+	uint8_t *msg_types;
+	uint8_t *msg_slots;
+	uint32_t *msg_payloads;
+	size_t npayloads;
+	struct demo_payload *payloads;
+	// The SAR checksum message the demo ends with, which is always decoded
+	// regardless of filter; its type is SAR_DATA_INVALID if there isn't one.
+	struct sar_data trailing_sum;
 	uint32_t checksum;
 	float tickrate;
+	// Set by demo_open if some message can't be made sense of, which is
+	// where demo_next stops; nothing after it is looked at.
+	bool corrupted;
 	enum {
 		V2SUM_NONE,
 		V2SUM_INVALID,
@@ -187,7 +250,77 @@ struct demo {
 	} v2sum_state;
 };
 
-struct demo *demo_parse(const char *path);
+// demo_init sets up what checking v2 signatures needs, and has to be called
+// before any demo is opened or demo_sig_prepare is used; demo_shutdown frees
+// it again once they're all done with.
+void demo_init(void);
+void demo_shutdown(void);
+
+// Goes through a demo once without decoding every message up front.
+// demo_open reads the header and the framing of every message; each demo_next
+// call then decodes the next message the filter keeps into msg, returning
+// false once the demo is exhausted (or breaks off). Anything msg points to is
+// reused by the following call, so beyond the columns above (a handful of
+// bytes a message) memory use doesn't grow with the demo. A NULL filter keeps
+// every message.
+//
+// demo_close finishes the checksums, filling in checksum, trailing_sum and
+// v2sum_state; any messages left over are walked first. The demo still has
+// to be released with demo_free afterwards.
+//
+// If arena is NULL, the demo gets a private arena which demo_free releases.
+// Otherwise the caller owns the arena and should arena_reset it once the demo
+// has been freed, which makes it cheap to reuse one arena for a whole batch.
+struct demo *demo_open(const char *path, struct arena *arena, const struct demo_filter *filter);
+// Like demo_open, but for a file the caller has already mapped; the demo takes
+// the mapping over, and unmaps it in demo_free even if this fails.
+struct demo *demo_open_mapping(const char *path, const struct util_mapping *map, struct arena *arena, const struct demo_filter *filter);
+// Opens a demo that's already in memory. The buffer isn't copied, so it has
+// to outlive the demo; name is only used in error messages.
+struct demo *demo_open_buffer(const char *name, const void *data, size_t size, struct arena *arena, const struct demo_filter *filter);
+bool demo_next(struct demo *demo, struct demo_msg *msg);
+// Optionally called straight after demo_open: instead of hashing the demo as
+// the messages go past, do it on up to nthreads threads for the CRC (plus one
+// for the signature) while the caller iterates. Only worth it for big demos.
+void demo_hash_in_background(struct demo *demo, unsigned nthreads);
+
+// A v2 signature checked ahead of time, so that lots of them can go through
+// ed25519_verify_batch together.
+struct demo_sig {
+	uint32_t sar_sum;
+	unsigned char signature[64];
+	bool valid;
+	// A hash of everything valid depends on (the signed data and the
+	// signature), so two demos with the same key get the same verdict
+	// whatever they're called.
+	unsigned char key[32];
+};
+
+// Hashes everything the v2 signatures of the n mapped demos in maps cover,
+// side by side. For each one that ends in a v2 checksum, in order, fills in
+// sigs[k] (all but valid) and ctxs[k], ready to be finished by
+// ed25519_verify_batch, and sets which[k] to its index in maps. Returns how
+// many that was. The mappings are left for the caller, who can then open the
+// demos on them with demo_open_mapping.
+size_t demo_sig_prepare(const struct util_mapping *maps, size_t n, struct demo_sig *sigs, ed25519_verify_context *ctxs, size_t *which);
+// Optionally called straight after demo_open with a checked result from
+// demo_sig_prepare for the same file, which demo_close then uses instead of
+// hashing for the signature again. It's ignored if the demo turns out to
+// carry a different signature.
+void demo_use_sig(struct demo *demo, const struct demo_sig *sig);
+// The same for the v1 demo checksum, e.g. one remembered from an earlier run:
+// demo_close reports it as the demo's checksum rather than working it out.
+void demo_use_checksum(struct demo *demo, uint32_t checksum);
+void demo_close(struct demo *demo);
 void demo_free(struct demo *demo);
 
+// Reads nothing but the fixed-size header at the start of a demo, for when
+// that's all that's needed. Returns 1 on failure.
+int demo_read_header(const char *path, struct arena *arena, struct demo_hdr *out);
+
+// Decodes a SAR data message from the demo. Any strings or arrays it needs
+// come from the demo's arena, or while iterating, from the memory the next
+// demo_next call reuses.
+void demo_decode_sar(struct demo *demo, const struct demo_msg *msg, struct sar_data *out);
+
 #endif
@@ -3,6 +3,8 @@
 
 #include <stddef.h>
 
+#include "sha512.h"
+
 #if defined(_WIN32)
     #if defined(ED25519_BUILD_DLL)
         #define ED25519_DECLSPEC __declspec(dllexport)
@@ -27,6 +29,54 @@ int ED25519_DECLSPEC ed25519_create_seed(unsigned char *seed);
 void ED25519_DECLSPEC ed25519_create_keypair(unsigned char *public_key, unsigned char *private_key, const unsigned char *seed);
 void ED25519_DECLSPEC ed25519_sign(unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key, const unsigned char *private_key);
 int ED25519_DECLSPEC ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key);
+/*
+    Incremental verification, for messages that are never held in memory in
+    one piece. Feed the message through any number of update calls between
+    init and final; final returns the same result ed25519_verify would for the
+    concatenated message.
+*/
+typedef struct {
+    sha512_context hash;
+    unsigned char signature[64];
+    unsigned char public_key[32];
+    const struct ed25519_fixed_key *fixed_key;
+} ed25519_verify_context;
+
+void ED25519_DECLSPEC ed25519_verify_init(ed25519_verify_context *ctx, const unsigned char *signature, const unsigned char *public_key);
+void ED25519_DECLSPEC ed25519_verify_update(ed25519_verify_context *ctx, const unsigned char *message, size_t message_len);
+/* ed25519_verify_update for n contexts at once, hashing their messages side by side */
+void ED25519_DECLSPEC ed25519_verify_update_multi(ed25519_verify_context *ctxs, const unsigned char *const *messages, const size_t *message_lens, size_t n);
+int ED25519_DECLSPEC ed25519_verify_final(ed25519_verify_context *ctx);
+
+/*
+    Finishes n contexts, fed as for ed25519_verify_final, checking their
+    signatures together. That's several times cheaper per signature than one
+    at a time, especially when they share a fixed key. valid[i] is set to 1 if
+    ctxs[i] verified and 0 if not; the return value is 1 if every one of them
+    is valid.
+
+    valid[i] is what ed25519_verify_final would have returned, except in one
+    edge case: the batch is cofactorless too, but signatures that each leave
+    a small-order residual (say the same order-2 point) can cancel out and
+    pass together where each one alone fails. Making such a signature takes
+    the private key, so no forgery gets through this way. A batch that fails
+    is redone one signature at a time, with ed25519_verify_final's results.
+*/
+int ED25519_DECLSPEC ed25519_verify_batch(ed25519_verify_context *ctxs, size_t n, int *valid);
+
+/*
+    A public key that many signatures are checked against, decompressed once
+    along with a table of its multiples. ed25519_fixed_key_create returns NULL
+    if out of memory; if the key isn't a valid point, nothing will verify
+    against it.
+*/
+typedef struct ed25519_fixed_key ed25519_fixed_key;
+
+ed25519_fixed_key ED25519_DECLSPEC *ed25519_fixed_key_create(const unsigned char *public_key);
+void ED25519_DECLSPEC ed25519_fixed_key_free(ed25519_fixed_key *key);
+int ED25519_DECLSPEC ed25519_verify_fixed(const unsigned char *signature, const unsigned char *message, size_t message_len, const ed25519_fixed_key *key);
+void ED25519_DECLSPEC ed25519_verify_init_fixed(ed25519_verify_context *ctx, const unsigned char *signature, const ed25519_fixed_key *key);
+
 void ED25519_DECLSPEC ed25519_add_scalar(unsigned char *public_key, unsigned char *private_key, const unsigned char *scalar);
 void ED25519_DECLSPEC ed25519_key_exchange(unsigned char *shared_secret, const unsigned char *public_key, const unsigned char *private_key);
 
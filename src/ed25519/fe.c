@@ -1,6 +1,8 @@
 #include "fixedint.h"
 #include "fe.h"
 
+/* the ref10 representation; see fe51.c for the other one */
+#ifndef ED25519_FE51
 
 /*
     helper functions
@@ -360,7 +362,10 @@ void fe_frombytes(fe h, const unsigned char *s) {
 }
 
 
+#endif
 
+
+/* shared by both representations */
 void fe_invert(fe out, const fe z) {
     fe t0;
     fe t1;
@@ -447,6 +452,8 @@ void fe_invert(fe out, const fe z) {
     fe_mul(out, t1, t0);
 }
 
+#ifndef ED25519_FE51
+
 
 
 /*
@@ -877,7 +884,10 @@ void fe_neg(fe h, const fe f) {
     h[9] = h9;
 }
 
+#endif
+
 
+/* shared by both representations */
 void fe_pow22523(fe out, const fe z) {
     fe t0;
     fe t1;
@@ -963,6 +973,8 @@ void fe_pow22523(fe out, const fe z) {
     return;
 }
 
+#ifndef ED25519_FE51
+
 
 /*
 h = f * f
@@ -1489,3 +1501,5 @@ void fe_tobytes(unsigned char *s, const fe h) {
     s[30] = (unsigned char) (h9 >> 10);
     s[31] = (unsigned char) (h9 >> 18);
 }
+
+#endif
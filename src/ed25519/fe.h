@@ -10,11 +10,53 @@
     An element t, entries t[0]...t[9], represents the integer
     t[0]+2^26 t[1]+2^51 t[2]+2^77 t[3]+2^102 t[4]+...+2^230 t[9].
     Bounds on each t[i] vary depending on context.
+
+    Where the compiler has a 128-bit integer type (64-bit targets), t is
+    instead five unsigned 51-bit limbs t[0]+2^51 t[1]+...+2^204 t[4] (fe51.c),
+    whose products each take one 64x64->128 multiply. Define ED25519_NO_FE51
+    to keep the ref10 representation there too.
 */
 
+#if defined(__SIZEOF_INT128__) && !defined(ED25519_NO_FE51)
+#define ED25519_FE51
+#endif
+
+#ifdef ED25519_FE51
+
+typedef uint64_t fe[5];
+
+/*
+    Constants are written as ref10 limbs with FE(...), so the tables are the
+    same source for both. Here they're regrouped in pairs (plus 2p, which keeps
+    them positive) and carried into 51-bit limbs at compile time.
+*/
+#define FE51_MASK ((UINT64_C(1) << 51) - 1)
+#define FE51_PAIR(lo, hi, two_p) ((uint64_t)((int64_t)(lo) + (int64_t)(hi) * 67108864 + (int64_t)(two_p)))
+#define FE51_S1(g0, g1) ((g1) + ((g0) >> 51))
+#define FE51_S2(g0, g1, g2) ((g2) + (FE51_S1(g0, g1) >> 51))
+#define FE51_S3(g0, g1, g2, g3) ((g3) + (FE51_S2(g0, g1, g2) >> 51))
+#define FE51_S4(g0, g1, g2, g3, g4) ((g4) + (FE51_S3(g0, g1, g2, g3) >> 51))
+#define FE51_CARRY(g0, g1, g2, g3, g4) { \
+    ((g0) & FE51_MASK) + 19 * (FE51_S4(g0, g1, g2, g3, g4) >> 51), \
+    FE51_S1(g0, g1) & FE51_MASK, \
+    FE51_S2(g0, g1, g2) & FE51_MASK, \
+    FE51_S3(g0, g1, g2, g3) & FE51_MASK, \
+    FE51_S4(g0, g1, g2, g3, g4) & FE51_MASK }
+#define FE(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9) FE51_CARRY( \
+    FE51_PAIR(f0, f1, INT64_C(0xfffffffffffda)), \
+    FE51_PAIR(f2, f3, INT64_C(0xffffffffffffe)), \
+    FE51_PAIR(f4, f5, INT64_C(0xffffffffffffe)), \
+    FE51_PAIR(f6, f7, INT64_C(0xffffffffffffe)), \
+    FE51_PAIR(f8, f9, INT64_C(0xffffffffffffe)))
+
+#else
 
 typedef int32_t fe[10];
 
+#define FE(f0, f1, f2, f3, f4, f5, f6, f7, f8, f9) { f0, f1, f2, f3, f4, f5, f6, f7, f8, f9 }
+
+#endif
+
 
 void fe_0(fe h);
 void fe_1(fe h);
@@ -0,0 +1,307 @@
+#include "fixedint.h"
+#include "fe.h"
+
+#ifdef ED25519_FE51
+
+/*
+    The 5 x 51-bit representation (see fe.h). Every function here takes limbs
+    below 2^52 and leaves them below 2^51 + 2^15, so values can be chained
+    through any of them without the careful bound tracking ref10 needs.
+
+    fe_invert and fe_pow22523 are only squarings and multiplications, so they
+    are shared with the ref10 code in fe.c.
+*/
+
+typedef unsigned __int128 uint128_t;
+
+#define MASK51 ((UINT64_C(1) << 51) - 1)
+
+static uint64_t load_8(const unsigned char *in) {
+    uint64_t result;
+    int i;
+
+    result = 0;
+
+    for (i = 7; i >= 0; --i) {
+        result = (result << 8) | in[i];
+    }
+
+    return result;
+}
+
+/* one pass of carries, wrapping the top one around as 2^255 = 19 */
+static void fe_carry(fe h) {
+    uint64_t c;
+
+    c = h[0] >> 51; h[0] &= MASK51; h[1] += c;
+    c = h[1] >> 51; h[1] &= MASK51; h[2] += c;
+    c = h[2] >> 51; h[2] &= MASK51; h[3] += c;
+    c = h[3] >> 51; h[3] &= MASK51; h[4] += c;
+    c = h[4] >> 51; h[4] &= MASK51; h[0] += c * 19;
+}
+
+/* the same, starting from 128-bit products */
+static void fe_carry_wide(fe h, uint128_t r0, uint128_t r1, uint128_t r2, uint128_t r3, uint128_t r4) {
+    uint64_t c;
+
+    r1 += (uint64_t)(r0 >> 51);
+    r2 += (uint64_t)(r1 >> 51);
+    r3 += (uint64_t)(r2 >> 51);
+    r4 += (uint64_t)(r3 >> 51);
+    c = (uint64_t)(r4 >> 51);
+
+    h[0] = ((uint64_t)r0 & MASK51) + c * 19;
+    h[1] = (uint64_t)r1 & MASK51;
+    h[2] = (uint64_t)r2 & MASK51;
+    h[3] = (uint64_t)r3 & MASK51;
+    h[4] = (uint64_t)r4 & MASK51;
+
+    c = h[0] >> 51; h[0] &= MASK51; h[1] += c;
+}
+
+
+void fe_0(fe h) {
+    h[0] = 0;
+    h[1] = 0;
+    h[2] = 0;
+    h[3] = 0;
+    h[4] = 0;
+}
+
+void fe_1(fe h) {
+    h[0] = 1;
+    h[1] = 0;
+    h[2] = 0;
+    h[3] = 0;
+    h[4] = 0;
+}
+
+void fe_copy(fe h, const fe f) {
+    h[0] = f[0];
+    h[1] = f[1];
+    h[2] = f[2];
+    h[3] = f[3];
+    h[4] = f[4];
+}
+
+
+/*
+    Ignores the top bit of s, like the ref10 version.
+*/
+
+void fe_frombytes(fe h, const unsigned char *s) {
+    h[0] = load_8(s) & MASK51;
+    h[1] = (load_8(s + 6) >> 3) & MASK51;
+    h[2] = (load_8(s + 12) >> 6) & MASK51;
+    h[3] = (load_8(s + 19) >> 1) & MASK51;
+    h[4] = (load_8(s + 24) >> 12) & MASK51;
+}
+
+
+/*
+    Fully reduces h mod p first, so the encoding is canonical.
+*/
+
+void fe_tobytes(unsigned char *s, const fe h) {
+    fe t;
+    uint64_t q;
+    int i;
+
+    fe_copy(t, h);
+    fe_carry(t);
+    fe_carry(t);
+
+    /* t < 2^255 + 19 now; q = 1 exactly when t >= p */
+    q = (t[0] + 19) >> 51;
+    q = (t[1] + q) >> 51;
+    q = (t[2] + q) >> 51;
+    q = (t[3] + q) >> 51;
+    q = (t[4] + q) >> 51;
+
+    t[0] += 19 * q;
+    t[1] += t[0] >> 51; t[0] &= MASK51;
+    t[2] += t[1] >> 51; t[1] &= MASK51;
+    t[3] += t[2] >> 51; t[2] &= MASK51;
+    t[4] += t[3] >> 51; t[3] &= MASK51;
+    t[4] &= MASK51;
+
+    for (i = 0; i < 32; ++i) {
+        s[i] = 0;
+    }
+
+    /* limb k starts at bit 51k */
+    for (i = 0; i < 5; ++i) {
+        int bit = 51 * i;
+        int byte = bit >> 3;
+        int shift = bit & 7;
+        uint128_t v = (uint128_t)t[i] << shift;
+        int j;
+
+        for (j = 0; j < 8 && byte + j < 32; ++j) {
+            s[byte + j] |= (unsigned char)(v >> (8 * j));
+        }
+    }
+}
+
+
+int fe_isnegative(const fe f) {
+    unsigned char s[32];
+
+    fe_tobytes(s, f);
+
+    return s[0] & 1;
+}
+
+int fe_isnonzero(const fe f) {
+    unsigned char s[32];
+    unsigned char r;
+    int i;
+
+    fe_tobytes(s, f);
+
+    r = 0;
+
+    for (i = 0; i < 32; ++i) {
+        r |= s[i];
+    }
+
+    return r != 0;
+}
+
+
+/*
+    Replace (f,g) with (g,g) if b == 1;
+    replace (f,g) with (f,g) if b == 0.
+
+    Preconditions: b in {0,1}.
+*/
+
+void fe_cmov(fe f, const fe g, unsigned int b) {
+    uint64_t mask = (uint64_t)0 - b;
+    int i;
+
+    for (i = 0; i < 5; ++i) {
+        f[i] ^= (f[i] ^ g[i]) & mask;
+    }
+}
+
+/*
+    Replace (f,g) with (g,f) if b == 1;
+    replace (f,g) with (f,g) if b == 0.
+
+    Preconditions: b in {0,1}.
+*/
+
+void fe_cswap(fe f, fe g, unsigned int b) {
+    uint64_t mask = (uint64_t)0 - b;
+    uint64_t x;
+    int i;
+
+    for (i = 0; i < 5; ++i) {
+        x = (f[i] ^ g[i]) & mask;
+        f[i] ^= x;
+        g[i] ^= x;
+    }
+}
+
+
+void fe_add(fe h, const fe f, const fe g) {
+    h[0] = f[0] + g[0];
+    h[1] = f[1] + g[1];
+    h[2] = f[2] + g[2];
+    h[3] = f[3] + g[3];
+    h[4] = f[4] + g[4];
+    fe_carry(h);
+}
+
+/*
+    4p is added first so nothing goes below zero.
+*/
+
+void fe_sub(fe h, const fe f, const fe g) {
+    h[0] = (f[0] + UINT64_C(0x1fffffffffffb4)) - g[0];
+    h[1] = (f[1] + UINT64_C(0x1ffffffffffffc)) - g[1];
+    h[2] = (f[2] + UINT64_C(0x1ffffffffffffc)) - g[2];
+    h[3] = (f[3] + UINT64_C(0x1ffffffffffffc)) - g[3];
+    h[4] = (f[4] + UINT64_C(0x1ffffffffffffc)) - g[4];
+    fe_carry(h);
+}
+
+void fe_neg(fe h, const fe f) {
+    fe zero;
+
+    fe_0(zero);
+    fe_sub(h, zero, f);
+}
+
+
+void fe_mul(fe h, const fe f, const fe g) {
+    uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+    uint64_t g0 = g[0], g1 = g[1], g2 = g[2], g3 = g[3], g4 = g[4];
+    uint64_t g1_19 = 19 * g1, g2_19 = 19 * g2, g3_19 = 19 * g3, g4_19 = 19 * g4;
+    uint128_t r0, r1, r2, r3, r4;
+
+    r0 = (uint128_t)f0 * g0 + (uint128_t)f1 * g4_19 + (uint128_t)f2 * g3_19 + (uint128_t)f3 * g2_19 + (uint128_t)f4 * g1_19;
+    r1 = (uint128_t)f0 * g1 + (uint128_t)f1 * g0    + (uint128_t)f2 * g4_19 + (uint128_t)f3 * g3_19 + (uint128_t)f4 * g2_19;
+    r2 = (uint128_t)f0 * g2 + (uint128_t)f1 * g1    + (uint128_t)f2 * g0    + (uint128_t)f3 * g4_19 + (uint128_t)f4 * g3_19;
+    r3 = (uint128_t)f0 * g3 + (uint128_t)f1 * g2    + (uint128_t)f2 * g1    + (uint128_t)f3 * g0    + (uint128_t)f4 * g4_19;
+    r4 = (uint128_t)f0 * g4 + (uint128_t)f1 * g3    + (uint128_t)f2 * g2    + (uint128_t)f3 * g1    + (uint128_t)f4 * g0;
+
+    fe_carry_wide(h, r0, r1, r2, r3, r4);
+}
+
+/*
+    h = f * 121666
+*/
+
+void fe_mul121666(fe h, fe f) {
+    fe_carry_wide(h,
+        (uint128_t)f[0] * 121666,
+        (uint128_t)f[1] * 121666,
+        (uint128_t)f[2] * 121666,
+        (uint128_t)f[3] * 121666,
+        (uint128_t)f[4] * 121666);
+}
+
+
+/*
+    h = f * f, times 2 if doubled: the cross terms only need computing once
+*/
+
+static void fe_sq_inner(fe h, const fe f, int doubled) {
+    uint64_t f0 = f[0], f1 = f[1], f2 = f[2], f3 = f[3], f4 = f[4];
+    uint64_t f0_2 = 2 * f0, f1_2 = 2 * f1;
+    uint64_t f1_38 = 38 * f1, f2_38 = 38 * f2, f3_38 = 38 * f3;
+    uint64_t f3_19 = 19 * f3, f4_19 = 19 * f4;
+    uint128_t r0, r1, r2, r3, r4;
+
+    r0 = (uint128_t)f0 * f0   + (uint128_t)f1_38 * f4 + (uint128_t)f2_38 * f3;
+    r1 = (uint128_t)f0_2 * f1 + (uint128_t)f2_38 * f4 + (uint128_t)f3_19 * f3;
+    r2 = (uint128_t)f0_2 * f2 + (uint128_t)f1 * f1     + (uint128_t)f3_38 * f4;
+    r3 = (uint128_t)f0_2 * f3 + (uint128_t)f1_2 * f2   + (uint128_t)f4_19 * f4;
+    r4 = (uint128_t)f0_2 * f4 + (uint128_t)f1_2 * f3   + (uint128_t)f2 * f2;
+
+    if (doubled) {
+        r0 <<= 1;
+        r1 <<= 1;
+        r2 <<= 1;
+        r3 <<= 1;
+        r4 <<= 1;
+    }
+
+    fe_carry_wide(h, r0, r1, r2, r3, r4);
+}
+
+void fe_sq(fe h, const fe f) {
+    fe_sq_inner(h, f, 0);
+}
+
+/*
+    h = 2 * f * f
+*/
+
+void fe_sq2(fe h, const fe f) {
+    fe_sq_inner(h, f, 1);
+}
+
+#endif
@@ -1,5 +1,9 @@
 #include "ge.h"
 #include "precomp_data.h"
+#include "precomp_verify.h"
+
+/* window of the variable-time base point multiples: Bi8 holds 2^(8-2) */
+#define BASE_WINDOW 8
 
 
 /*
@@ -22,10 +26,15 @@ void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q) {
 }
 
 
-static void slide(signed char *r, const unsigned char *a) {
+/*
+Signed sliding window recoding of a: every nonzero digit is odd and at most
+2^(w-1)-1 in magnitude, so only the odd multiples up to that are needed.
+*/
+static void slide(signed char *r, const unsigned char *a, int w) {
     int i;
     int b;
     int k;
+    int bound = (1 << (w - 1)) - 1;
 
     for (i = 0; i < 256; ++i) {
         r[i] = 1 & (a[i >> 3] >> (i & 7));
@@ -33,12 +42,12 @@ static void slide(signed char *r, const unsigned char *a) {
 
     for (i = 0; i < 256; ++i)
         if (r[i]) {
-            for (b = 1; b <= 6 && i + b < 256; ++b) {
+            for (b = 1; b <= w + 1 && i + b < 256; ++b) {
                 if (r[i + b]) {
-                    if (r[i] + (r[i + b] << b) <= 15) {
+                    if (r[i] + (r[i + b] << b) <= bound) {
                         r[i] += r[i + b] << b;
                         r[i + b] = 0;
-                    } else if (r[i] - (r[i + b] << b) >= -15) {
+                    } else if (r[i] - (r[i + b] << b) >= -bound) {
                         r[i] -= r[i + b] << b;
 
                         for (k = i + b; k < 256; ++k) {
@@ -57,47 +66,43 @@ static void slide(signed char *r, const unsigned char *a) {
         }
 }
 
+/*
+Ai = A,3A,5A,...,(2*count-1)A
+*/
+
+void ge_odd_multiples(ge_cached *Ai, const ge_p3 *A, int count) {
+    ge_p1p1 t;
+    ge_p3 u;
+    ge_p3 A2;
+    int i;
+    ge_p3_to_cached(&Ai[0], A);
+    ge_p3_dbl(&t, A);
+    ge_p1p1_to_p3(&A2, &t);
+
+    for (i = 1; i < count; ++i) {
+        ge_add(&t, &A2, &Ai[i - 1]);
+        ge_p1p1_to_p3(&u, &t);
+        ge_p3_to_cached(&Ai[i], &u);
+    }
+}
+
 /*
 r = a * A + b * B
 where a = a[0]+256*a[1]+...+256^31 a[31].
 and b = b[0]+256*b[1]+...+256^31 b[31].
 B is the Ed25519 base point (x,4/5) with x positive.
+Ai holds the odd multiples of A up to 2^(aw-1)-1, as from ge_odd_multiples,
+and Bt those of B up to 2^(bw-1)-1.
 */
 
-void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+static void double_scalarmult(ge_p2 *r, const unsigned char *a, const ge_cached *Ai, int aw, const unsigned char *b, const ge_precomp *Bt, int bw) {
     signed char aslide[256];
     signed char bslide[256];
-    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
     ge_p1p1 t;
     ge_p3 u;
-    ge_p3 A2;
     int i;
-    slide(aslide, a);
-    slide(bslide, b);
-    ge_p3_to_cached(&Ai[0], A);
-    ge_p3_dbl(&t, A);
-    ge_p1p1_to_p3(&A2, &t);
-    ge_add(&t, &A2, &Ai[0]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[1], &u);
-    ge_add(&t, &A2, &Ai[1]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[2], &u);
-    ge_add(&t, &A2, &Ai[2]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[3], &u);
-    ge_add(&t, &A2, &Ai[3]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[4], &u);
-    ge_add(&t, &A2, &Ai[4]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[5], &u);
-    ge_add(&t, &A2, &Ai[5]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[6], &u);
-    ge_add(&t, &A2, &Ai[6]);
-    ge_p1p1_to_p3(&u, &t);
-    ge_p3_to_cached(&Ai[7], &u);
+    slide(aslide, a, aw);
+    slide(bslide, b, bw);
     ge_p2_0(r);
 
     for (i = 255; i >= 0; --i) {
@@ -119,10 +124,90 @@ void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3
 
         if (bslide[i] > 0) {
             ge_p1p1_to_p3(&u, &t);
-            ge_madd(&t, &u, &Bi[bslide[i] / 2]);
+            ge_madd(&t, &u, &Bt[bslide[i] / 2]);
+        } else if (bslide[i] < 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_msub(&t, &u, &Bt[(-bslide[i]) / 2]);
+        }
+
+        ge_p1p1_to_p2(r, &t);
+    }
+}
+
+void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+    ge_cached Ai[1 << (GE_VERIFY_WINDOW - 2)];
+    ge_odd_multiples(Ai, A, 1 << (GE_VERIFY_WINDOW - 2));
+    double_scalarmult(r, a, Ai, GE_VERIFY_WINDOW, b, Bi8, BASE_WINDOW);
+}
+
+/*
+The original ref10 layout: width 5 for both points and only the 8-entry Bi.
+Same result as ge_double_scalarmult_vartime, kept to check that against.
+*/
+
+void ge_double_scalarmult_vartime_compact(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+    ge_odd_multiples(Ai, A, 8);
+    double_scalarmult(r, a, Ai, 5, b, Bi, 5);
+}
+
+void ge_double_scalarmult_vartime_fixed(ge_p2 *r, const unsigned char *a, const ge_cached *Ai, const unsigned char *b) {
+    double_scalarmult(r, a, Ai, GE_FIXED_WINDOW, b, Bi8, BASE_WINDOW);
+}
+
+
+/*
+r = b * B + scalars[0] * P_0 + ... + scalars[n-1] * P_(n-1)
+where tables[k] holds the odd multiples of P_k for a window of windows[k]
+bits, as from ge_odd_multiples. All the terms share one run of doublings,
+which is what makes batch verification cheap. n is at most GE_MULTI_MAX.
+*/
+
+void ge_multi_scalarmult_vartime(ge_p2 *r, const unsigned char *b, int n, unsigned char (*scalars)[32], const ge_cached *const *tables, const int *windows) {
+    signed char slides[GE_MULTI_MAX][256];
+    signed char bslide[256];
+    ge_p1p1 t;
+    ge_p3 u;
+    int i;
+    int k;
+    int top = -1;
+    for (k = 0; k < n; ++k) {
+        slide(slides[k], scalars[k], windows[k]);
+    }
+    slide(bslide, b, BASE_WINDOW);
+    ge_p2_0(r);
+
+    for (i = 255; i >= 0 && top < 0; --i) {
+        if (bslide[i]) {
+            top = i;
+        }
+
+        for (k = 0; k < n && top < 0; ++k) {
+            if (slides[k][i]) {
+                top = i;
+            }
+        }
+    }
+
+    for (i = top; i >= 0; --i) {
+        ge_p2_dbl(&t, r);
+
+        for (k = 0; k < n; ++k) {
+            if (slides[k][i] > 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_add(&t, &u, &tables[k][slides[k][i] / 2]);
+            } else if (slides[k][i] < 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_sub(&t, &u, &tables[k][(-slides[k][i]) / 2]);
+            }
+        }
+
+        if (bslide[i] > 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_madd(&t, &u, &Bi8[bslide[i] / 2]);
         } else if (bslide[i] < 0) {
             ge_p1p1_to_p3(&u, &t);
-            ge_msub(&t, &u, &Bi[(-bslide[i]) / 2]);
+            ge_msub(&t, &u, &Bi8[(-bslide[i]) / 2]);
         }
 
         ge_p1p1_to_p2(r, &t);
@@ -130,13 +215,13 @@ void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3
 }
 
 
-static const fe d = {
+static const fe d = FE(
     -10913610, 13857413, -15372611, 6949391, 114729, -8787816, -6275908, -3247719, -18696448, -12055116
-};
+);
 
-static const fe sqrtm1 = {
+static const fe sqrtm1 = FE(
     -32595792, -7943725, 9377950, 3500415, 12389472, -272473, -25146209, -2005654, 326686, 11406482
-};
+);
 
 int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s) {
     fe u;
@@ -295,9 +380,9 @@ void ge_p3_dbl(ge_p1p1 *r, const ge_p3 *p) {
 r = p
 */
 
-static const fe d2 = {
+static const fe d2 = FE(
     -21827239, -5839606, -30745221, 13898782, 229458, 15978800, -12551817, -6495438, 29715968, 9444199
-};
+);
 
 void ge_p3_to_cached(ge_cached *r, const ge_p3 *p) {
     fe_add(r->YplusX, p->Y, p->X);
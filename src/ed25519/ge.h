@@ -51,6 +51,24 @@ typedef struct {
   fe T2d;
 } ge_cached;
 
+/*
+Window for a public key seen once in ge_double_scalarmult_vartime: its
+2^(w-2) odd multiples are built per call, which is what keeps this small.
+The base point side always uses a width-8 precomputed table.
+*/
+#define GE_VERIFY_WINDOW 5
+
+/*
+A point that is used over and over (a fixed public key) can afford a wider
+window than one that is only seen once: GE_FIXED_MULTIPLES odd multiples,
+built once with ge_odd_multiples, for ge_double_scalarmult_vartime_fixed.
+*/
+#define GE_FIXED_WINDOW 7
+#define GE_FIXED_MULTIPLES (1 << (GE_FIXED_WINDOW - 2))
+
+/* most terms ge_multi_scalarmult_vartime takes, besides the base point */
+#define GE_MULTI_MAX 32
+
 void ge_p3_tobytes(unsigned char *s, const ge_p3 *h);
 void ge_tobytes(unsigned char *s, const ge_p2 *h);
 int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s);
@@ -58,6 +76,10 @@ int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s);
 void ge_add(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
 void ge_sub(ge_p1p1 *r, const ge_p3 *p, const ge_cached *q);
 void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b);
+void ge_double_scalarmult_vartime_compact(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b);
+void ge_double_scalarmult_vartime_fixed(ge_p2 *r, const unsigned char *a, const ge_cached *Ai, const unsigned char *b);
+void ge_odd_multiples(ge_cached *Ai, const ge_p3 *A, int count);
+void ge_multi_scalarmult_vartime(ge_p2 *r, const unsigned char *b, int n, unsigned char (*scalars)[32], const ge_cached *const *tables, const int *windows);
 void ge_madd(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q);
 void ge_msub(ge_p1p1 *r, const ge_p3 *p, const ge_precomp *q);
 void ge_scalarmult_base(ge_p3 *h, const unsigned char *a);
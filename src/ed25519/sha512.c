@@ -273,3 +273,274 @@ int sha512(const unsigned char *message, size_t message_len, unsigned char *out)
     if ((ret = sha512_final(&ctx, out))) return ret;
     return 0;
 }
+
+
+/*
+   Multi-buffer hashing: independent messages are compressed side by side, one
+   per 64-bit SIMD lane, so a round costs the same for 4 or 8 messages as it
+   does for one. Only whole blocks go through the lanes; partial blocks at
+   either end of a message go through sha512_update as usual.
+*/
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define SHA512_X86
+#include <immintrin.h>
+#endif
+
+#ifdef SHA512_X86
+
+#define SHA512_X4_ROR(x, n) _mm256_or_si256(_mm256_srli_epi64(x, n), _mm256_slli_epi64(x, 64 - (n)))
+#define SHA512_X4_XOR3(x, y, z) _mm256_xor_si256(_mm256_xor_si256(x, y), z)
+
+/* compress one block for each of 4 contexts */
+__attribute__((target("avx2")))
+static void sha512_compress_x4(sha512_context **mds, const unsigned char **blocks)
+{
+    __m256i s[8], W[80], t0, t1;
+    uint64_t w[4][16], out[4];
+    int i, l;
+
+    for (l = 0; l < 4; l++) {
+        for (i = 0; i < 16; i++) {
+            LOAD64H(w[l][i], blocks[l] + (8*i));
+        }
+    }
+
+    for (i = 0; i < 8; i++) {
+        s[i] = _mm256_set_epi64x(mds[3]->state[i], mds[2]->state[i], mds[1]->state[i], mds[0]->state[i]);
+    }
+
+    for (i = 0; i < 16; i++) {
+        W[i] = _mm256_set_epi64x(w[3][i], w[2][i], w[1][i], w[0][i]);
+    }
+
+    for (i = 16; i < 80; i++) {
+        __m256i g1 = SHA512_X4_XOR3(SHA512_X4_ROR(W[i - 2], 19), SHA512_X4_ROR(W[i - 2], 61), _mm256_srli_epi64(W[i - 2], 6));
+        __m256i g0 = SHA512_X4_XOR3(SHA512_X4_ROR(W[i - 15], 1), SHA512_X4_ROR(W[i - 15], 8), _mm256_srli_epi64(W[i - 15], 7));
+        W[i] = _mm256_add_epi64(_mm256_add_epi64(g1, W[i - 7]), _mm256_add_epi64(g0, W[i - 16]));
+    }
+
+    #define RND(a,b,c,d,e,f,g,h,i) \
+    t0 = _mm256_add_epi64(_mm256_add_epi64(h, SHA512_X4_XOR3(SHA512_X4_ROR(e, 14), SHA512_X4_ROR(e, 18), SHA512_X4_ROR(e, 41))), \
+         _mm256_add_epi64(_mm256_xor_si256(g, _mm256_and_si256(e, _mm256_xor_si256(f, g))), \
+         _mm256_add_epi64(_mm256_set1_epi64x(K[i]), W[i]))); \
+    t1 = _mm256_add_epi64(SHA512_X4_XOR3(SHA512_X4_ROR(a, 28), SHA512_X4_ROR(a, 34), SHA512_X4_ROR(a, 39)), \
+         _mm256_or_si256(_mm256_and_si256(_mm256_or_si256(a, b), c), _mm256_and_si256(a, b))); \
+    d = _mm256_add_epi64(d, t0); \
+    h = _mm256_add_epi64(t0, t1);
+
+    for (i = 0; i < 80; i += 8) {
+        RND(s[0],s[1],s[2],s[3],s[4],s[5],s[6],s[7],i+0);
+        RND(s[7],s[0],s[1],s[2],s[3],s[4],s[5],s[6],i+1);
+        RND(s[6],s[7],s[0],s[1],s[2],s[3],s[4],s[5],i+2);
+        RND(s[5],s[6],s[7],s[0],s[1],s[2],s[3],s[4],i+3);
+        RND(s[4],s[5],s[6],s[7],s[0],s[1],s[2],s[3],i+4);
+        RND(s[3],s[4],s[5],s[6],s[7],s[0],s[1],s[2],i+5);
+        RND(s[2],s[3],s[4],s[5],s[6],s[7],s[0],s[1],i+6);
+        RND(s[1],s[2],s[3],s[4],s[5],s[6],s[7],s[0],i+7);
+    }
+
+    #undef RND
+
+    for (i = 0; i < 8; i++) {
+        _mm256_storeu_si256((__m256i *)out, s[i]);
+        for (l = 0; l < 4; l++) {
+            mds[l]->state[i] += out[l];
+        }
+    }
+}
+
+#define SHA512_X8_XOR3(x, y, z) _mm512_ternarylogic_epi64(x, y, z, 0x96)
+
+/* compress one block for each of 8 contexts */
+__attribute__((target("avx512f")))
+static void sha512_compress_x8(sha512_context **mds, const unsigned char **blocks)
+{
+    __m512i s[8], W[80], t0, t1;
+    uint64_t w[8][16], out[8];
+    int i, l;
+
+    for (l = 0; l < 8; l++) {
+        for (i = 0; i < 16; i++) {
+            LOAD64H(w[l][i], blocks[l] + (8*i));
+        }
+    }
+
+    for (i = 0; i < 8; i++) {
+        s[i] = _mm512_set_epi64(mds[7]->state[i], mds[6]->state[i], mds[5]->state[i], mds[4]->state[i],
+                                mds[3]->state[i], mds[2]->state[i], mds[1]->state[i], mds[0]->state[i]);
+    }
+
+    for (i = 0; i < 16; i++) {
+        W[i] = _mm512_set_epi64(w[7][i], w[6][i], w[5][i], w[4][i], w[3][i], w[2][i], w[1][i], w[0][i]);
+    }
+
+    for (i = 16; i < 80; i++) {
+        __m512i g1 = SHA512_X8_XOR3(_mm512_ror_epi64(W[i - 2], 19), _mm512_ror_epi64(W[i - 2], 61), _mm512_srli_epi64(W[i - 2], 6));
+        __m512i g0 = SHA512_X8_XOR3(_mm512_ror_epi64(W[i - 15], 1), _mm512_ror_epi64(W[i - 15], 8), _mm512_srli_epi64(W[i - 15], 7));
+        W[i] = _mm512_add_epi64(_mm512_add_epi64(g1, W[i - 7]), _mm512_add_epi64(g0, W[i - 16]));
+    }
+
+    /* Ch and Maj are single ternary logic ops */
+    #define RND(a,b,c,d,e,f,g,h,i) \
+    t0 = _mm512_add_epi64(_mm512_add_epi64(h, SHA512_X8_XOR3(_mm512_ror_epi64(e, 14), _mm512_ror_epi64(e, 18), _mm512_ror_epi64(e, 41))), \
+         _mm512_add_epi64(_mm512_ternarylogic_epi64(e, f, g, 0xCA), \
+         _mm512_add_epi64(_mm512_set1_epi64(K[i]), W[i]))); \
+    t1 = _mm512_add_epi64(SHA512_X8_XOR3(_mm512_ror_epi64(a, 28), _mm512_ror_epi64(a, 34), _mm512_ror_epi64(a, 39)), \
+         _mm512_ternarylogic_epi64(a, b, c, 0xE8)); \
+    d = _mm512_add_epi64(d, t0); \
+    h = _mm512_add_epi64(t0, t1);
+
+    for (i = 0; i < 80; i += 8) {
+        RND(s[0],s[1],s[2],s[3],s[4],s[5],s[6],s[7],i+0);
+        RND(s[7],s[0],s[1],s[2],s[3],s[4],s[5],s[6],i+1);
+        RND(s[6],s[7],s[0],s[1],s[2],s[3],s[4],s[5],i+2);
+        RND(s[5],s[6],s[7],s[0],s[1],s[2],s[3],s[4],i+3);
+        RND(s[4],s[5],s[6],s[7],s[0],s[1],s[2],s[3],i+4);
+        RND(s[3],s[4],s[5],s[6],s[7],s[0],s[1],s[2],i+5);
+        RND(s[2],s[3],s[4],s[5],s[6],s[7],s[0],s[1],i+6);
+        RND(s[1],s[2],s[3],s[4],s[5],s[6],s[7],s[0],i+7);
+    }
+
+    #undef RND
+
+    for (i = 0; i < 8; i++) {
+        _mm512_storeu_si512((void *)out, s[i]);
+        for (l = 0; l < 8; l++) {
+            mds[l]->state[i] += out[l];
+        }
+    }
+}
+
+#endif
+
+/* how many messages this CPU can compress at once */
+int sha512_multi_width(void)
+{
+#ifdef SHA512_X86
+    if (__builtin_cpu_supports("avx512f")) return 8;
+    if (__builtin_cpu_supports("avx2")) return 4;
+#endif
+    return 1;
+}
+
+typedef struct {
+    sha512_context *md;
+    const unsigned char *in;
+    size_t inlen;
+} sha512_lane;
+
+/**
+   Process n independent messages, as sha512_update(mds[i], ins[i], inlens[i])
+   would for each, as many at a time as the CPU allows
+   @param mds    The hash states
+   @param ins    The data to hash into each
+   @param inlens The length of each (octets)
+   @param n      How many there are
+   @param width  The most to compress at once; anything over what
+                 sha512_multi_width returns is cut down to that
+*/
+void sha512_update_multi_width(sha512_context *const *mds, const unsigned char *const *ins, const size_t *inlens, size_t n, int width)
+{
+    static const unsigned char idle_block[128] = {0};
+    sha512_context idle[8];
+    sha512_lane lanes[8];
+    sha512_context *lane_mds[8];
+    const unsigned char *lane_blocks[8];
+    size_t next = 0;
+    size_t fill;
+    int nlanes = 0;
+    int kernel;
+    int l;
+
+#ifdef SHA512_X86
+    /* there's only a kernel for as many lanes as the CPU supports */
+    if (width > sha512_multi_width()) {
+        width = sha512_multi_width();
+    }
+#else
+    /* and elsewhere there are no kernels at all */
+    width = 1;
+#endif
+
+    if (width < 2) {
+        for (; next < n; next++) {
+            sha512_update(mds[next], ins[next], inlens[next]);
+        }
+        return;
+    }
+
+    for (l = 0; l < 8; l++) {
+        sha512_init(&idle[l]);
+    }
+
+    for (;;) {
+        /* keep every lane busy while there are messages left to start */
+        while (nlanes < width && next < n) {
+            sha512_lane lane;
+            lane.md = mds[next];
+            lane.in = ins[next];
+            lane.inlen = inlens[next];
+            next++;
+
+            if (lane.md->curlen > 0) {
+                fill = MIN(lane.inlen, 128 - lane.md->curlen);
+                sha512_update(lane.md, lane.in, fill);
+                lane.in += fill;
+                lane.inlen -= fill;
+            }
+
+            if (lane.md->curlen == 0 && lane.inlen >= 128) {
+                lanes[nlanes++] = lane;
+            } else {
+                sha512_update(lane.md, lane.in, lane.inlen);
+            }
+        }
+
+        /* only once everything has been started */
+        if (nlanes < 2) {
+            break;
+        }
+
+        /* the narrowest kernel that fits, with any spare lanes idling */
+        kernel = nlanes <= 4 ? 4 : 8;
+        for (l = 0; l < kernel; l++) {
+            if (l < nlanes) {
+                lane_mds[l] = lanes[l].md;
+                lane_blocks[l] = lanes[l].in;
+            } else {
+                lane_mds[l] = &idle[l];
+                lane_blocks[l] = idle_block;
+            }
+        }
+
+#ifdef SHA512_X86
+        if (kernel == 4) {
+            sha512_compress_x4(lane_mds, lane_blocks);
+        } else {
+            sha512_compress_x8(lane_mds, lane_blocks);
+        }
+#endif
+
+        for (l = 0; l < nlanes; l++) {
+            lanes[l].md->length += 128 * 8;
+            lanes[l].in += 128;
+            lanes[l].inlen -= 128;
+
+            /* done with whole blocks: the rest goes in the buffer */
+            if (lanes[l].inlen < 128) {
+                sha512_update(lanes[l].md, lanes[l].in, lanes[l].inlen);
+                lanes[l--] = lanes[--nlanes];
+            }
+        }
+    }
+
+    for (l = 0; l < nlanes; l++) {
+        sha512_update(lanes[l].md, lanes[l].in, lanes[l].inlen);
+    }
+}
+
+void sha512_update_multi(sha512_context *const *mds, const unsigned char *const *ins, const size_t *inlens, size_t n)
+{
+    sha512_update_multi_width(mds, ins, inlens, n, sha512_multi_width());
+}
@@ -18,4 +18,16 @@ int sha512_final(sha512_context * md, unsigned char *out);
 int sha512_update(sha512_context * md, const unsigned char *in, size_t inlen);
 int sha512(const unsigned char *message, size_t message_len, unsigned char *out);
 
+/*
+    Hashes n independent messages together, each into its own context, as if
+    by sha512_update one after another. On x86 with AVX2 or AVX-512 up to 4 or
+    8 of them are compressed at once in SIMD lanes; elsewhere it's just the
+    loop. The _width variant takes the lane count explicitly, for testing;
+    it's never more than sha512_multi_width, so any width gives the right
+    digests.
+*/
+void sha512_update_multi(sha512_context *const *mds, const unsigned char *const *ins, const size_t *inlens, size_t n);
+void sha512_update_multi_width(sha512_context *const *mds, const unsigned char *const *ins, const size_t *inlens, size_t n, int width);
+int sha512_multi_width(void);
+
 #endif
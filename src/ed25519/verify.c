@@ -1,8 +1,17 @@
+#include <stdlib.h>
+#include <string.h>
+
 #include "ed25519.h"
 #include "sha512.h"
 #include "ge.h"
 #include "sc.h"
 
+struct ed25519_fixed_key {
+    unsigned char public_key[32];
+    int valid;
+    ge_cached multiples[GE_FIXED_MULTIPLES];
+};
+
 static int consttime_equal(const unsigned char *x, const unsigned char *y) {
     unsigned char r = 0;
 
@@ -44,10 +53,8 @@ static int consttime_equal(const unsigned char *x, const unsigned char *y) {
     return !r;
 }
 
-int ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
-    unsigned char h[64];
+static int verify_hram(const unsigned char *signature, unsigned char *h, const unsigned char *public_key) {
     unsigned char checker[32];
-    sha512_context hash;
     ge_p3 A;
     ge_p2 R;
 
@@ -59,12 +66,6 @@ int ed25519_verify(const unsigned char *signature, const unsigned char *message,
         return 0;
     }
 
-    sha512_init(&hash);
-    sha512_update(&hash, signature, 32);
-    sha512_update(&hash, public_key, 32);
-    sha512_update(&hash, message, message_len);
-    sha512_final(&hash, h);
-    
     sc_reduce(h);
     ge_double_scalarmult_vartime(&R, h, &A, signature + 32);
     ge_tobytes(checker, &R);
@@ -75,3 +76,310 @@ int ed25519_verify(const unsigned char *signature, const unsigned char *message,
 
     return 1;
 }
+
+static int verify_hram_fixed(const unsigned char *signature, unsigned char *h, const ed25519_fixed_key *key) {
+    unsigned char checker[32];
+    ge_p2 R;
+
+    if (signature[63] & 224 || !key->valid) {
+        return 0;
+    }
+
+    sc_reduce(h);
+    ge_double_scalarmult_vartime_fixed(&R, h, key->multiples, signature + 32);
+    ge_tobytes(checker, &R);
+
+    if (!consttime_equal(checker, signature)) {
+        return 0;
+    }
+
+    return 1;
+}
+
+ed25519_fixed_key *ed25519_fixed_key_create(const unsigned char *public_key) {
+    ed25519_fixed_key *key = malloc(sizeof *key);
+    ge_p3 A;
+    int i;
+
+    if (!key) {
+        return NULL;
+    }
+
+    for (i = 0; i < 32; ++i) {
+        key->public_key[i] = public_key[i];
+    }
+
+    /* negated, as in verify_hram */
+    key->valid = ge_frombytes_negate_vartime(&A, public_key) == 0;
+
+    if (key->valid) {
+        ge_odd_multiples(key->multiples, &A, GE_FIXED_MULTIPLES);
+    }
+
+    return key;
+}
+
+void ed25519_fixed_key_free(ed25519_fixed_key *key) {
+    free(key);
+}
+
+int ed25519_verify_fixed(const unsigned char *signature, const unsigned char *message, size_t message_len, const ed25519_fixed_key *key) {
+    ed25519_verify_context ctx;
+
+    ed25519_verify_init_fixed(&ctx, signature, key);
+    ed25519_verify_update(&ctx, message, message_len);
+    return ed25519_verify_final(&ctx);
+}
+
+int ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
+    ed25519_verify_context ctx;
+
+    ed25519_verify_init(&ctx, signature, public_key);
+    ed25519_verify_update(&ctx, message, message_len);
+    return ed25519_verify_final(&ctx);
+}
+
+void ed25519_verify_init(ed25519_verify_context *ctx, const unsigned char *signature, const unsigned char *public_key) {
+    int i;
+
+    for (i = 0; i < 64; ++i) {
+        ctx->signature[i] = signature[i];
+    }
+
+    for (i = 0; i < 32; ++i) {
+        ctx->public_key[i] = public_key[i];
+    }
+
+    ctx->fixed_key = NULL;
+
+    sha512_init(&ctx->hash);
+    sha512_update(&ctx->hash, signature, 32);
+    sha512_update(&ctx->hash, public_key, 32);
+}
+
+void ed25519_verify_init_fixed(ed25519_verify_context *ctx, const unsigned char *signature, const ed25519_fixed_key *key) {
+    ed25519_verify_init(ctx, signature, key->public_key);
+    ctx->fixed_key = key;
+}
+
+void ed25519_verify_update(ed25519_verify_context *ctx, const unsigned char *message, size_t message_len) {
+    sha512_update(&ctx->hash, message, message_len);
+}
+
+void ed25519_verify_update_multi(ed25519_verify_context *ctxs, const unsigned char *const *messages, const size_t *message_lens, size_t n) {
+    sha512_context *mds[64];
+    size_t done;
+    size_t m;
+    size_t i;
+
+    for (done = 0; done < n; done += m) {
+        m = n - done < 64 ? n - done : 64;
+
+        for (i = 0; i < m; ++i) {
+            mds[i] = &ctxs[done + i].hash;
+        }
+
+        sha512_update_multi(mds, messages + done, message_lens + done, m);
+    }
+}
+
+int ed25519_verify_final(ed25519_verify_context *ctx) {
+    unsigned char h[64];
+
+    sha512_final(&ctx->hash, h);
+
+    if (ctx->fixed_key) {
+        return verify_hram_fixed(ctx->signature, h, ctx->fixed_key);
+    }
+
+    return verify_hram(ctx->signature, h, ctx->public_key);
+}
+
+/*
+    One batch of signatures (R_i, S_i) against keys A_i with hashes h_i checks
+
+        (sum z_i S_i) B - sum z_i R_i - sum z_i h_i A_i = 0
+
+    for random odd 128-bit z_i in a single multi-scalar multiplication, where
+    the A terms of every context sharing a fixed key collapse into one. If all
+    the signatures are good this always holds; if any is bad it holds with
+    negligible probability, unless all that's wrong is a small-order residual
+    that another signature's cancels (see ed25519_verify_batch in ed25519.h).
+    Anything the single check would reject outright (a high S, or an R that
+    isn't a canonical point encoding) fails the batch up front rather than
+    being trusted to the equation.
+
+    Takes as many of the n contexts (with their finished hashes in h) as fit
+    in GE_MULTI_MAX terms and returns how many it took, or 0 if the batch
+    didn't pass.
+*/
+static size_t verify_batch_step(unsigned char (*h)[64], const ed25519_verify_context *ctxs, size_t n, const unsigned char *seed, size_t base) {
+    ge_cached R_multiples[GE_MULTI_MAX][8];
+    ge_cached A_multiples[GE_MULTI_MAX][8];
+    const ed25519_fixed_key *fixed[GE_MULTI_MAX];
+    unsigned char scalars[GE_MULTI_MAX][32];
+    const ge_cached *tables[GE_MULTI_MAX];
+    int windows[GE_MULTI_MAX];
+    unsigned char identity[32] = {1};
+    unsigned char sB[32] = {0};
+    unsigned char z[32];
+    unsigned char hr[64];
+    unsigned char checker[32];
+    unsigned char zseed[36];
+    sha512_context hash;
+    ge_p3 negR;
+    ge_p3 negA;
+    ge_p2 sum;
+    int nterms = 0;
+    int nR = 0;
+    int nA = 0;
+    int k;
+    size_t i;
+
+    for (i = 0; i < n && nterms + 2 <= GE_MULTI_MAX; ++i) {
+        const ed25519_verify_context *ctx = &ctxs[i];
+        const unsigned char *signature = ctx->signature;
+        int key_term = -1;
+
+        if (signature[63] & 224) {
+            return 0;
+        }
+
+        /* -R, checking it round trips to exactly the bytes given */
+        if (ge_frombytes_negate_vartime(&negR, signature) != 0) {
+            return 0;
+        }
+
+        fe_neg(negR.X, negR.X);
+        fe_neg(negR.T, negR.T);
+        ge_p3_tobytes(checker, &negR);
+        fe_neg(negR.X, negR.X);
+        fe_neg(negR.T, negR.T);
+
+        if (memcmp(checker, signature, 32) != 0) {
+            return 0;
+        }
+
+        /* z_i = H(seed || index), cut to 128 bits and made odd */
+        memcpy(zseed, seed, 32);
+        zseed[32] = (base + i) >> 0;
+        zseed[33] = (base + i) >> 8;
+        zseed[34] = (base + i) >> 16;
+        zseed[35] = (base + i) >> 24;
+        sha512_init(&hash);
+        sha512_update(&hash, zseed, sizeof zseed);
+        sha512_final(&hash, hr);
+        memset(z, 0, sizeof z);
+        memcpy(z, hr, 16);
+        z[0] |= 1;
+
+        memcpy(hr, h[i], 64);
+        sc_reduce(hr);
+
+        ge_odd_multiples(R_multiples[nR], &negR, 8);
+        memcpy(scalars[nterms], z, 32);
+        tables[nterms] = R_multiples[nR];
+        windows[nterms] = 5;
+        fixed[nterms] = NULL;
+        ++nR;
+        ++nterms;
+
+        sc_muladd(sB, z, signature + 32, sB);
+
+        if (ctx->fixed_key) {
+            if (!ctx->fixed_key->valid) {
+                return 0;
+            }
+
+            for (k = 0; k < nterms; ++k) {
+                if (fixed[k] == ctx->fixed_key) {
+                    key_term = k;
+                }
+            }
+
+            if (key_term < 0) {
+                key_term = nterms++;
+                memset(scalars[key_term], 0, 32);
+                tables[key_term] = ctx->fixed_key->multiples;
+                windows[key_term] = GE_FIXED_WINDOW;
+                fixed[key_term] = ctx->fixed_key;
+            }
+        } else {
+            if (ge_frombytes_negate_vartime(&negA, ctx->public_key) != 0) {
+                return 0;
+            }
+
+            ge_odd_multiples(A_multiples[nA], &negA, 8);
+            key_term = nterms++;
+            memset(scalars[key_term], 0, 32);
+            tables[key_term] = A_multiples[nA];
+            windows[key_term] = 5;
+            fixed[key_term] = NULL;
+            ++nA;
+        }
+
+        sc_muladd(scalars[key_term], z, hr, scalars[key_term]);
+    }
+
+    ge_multi_scalarmult_vartime(&sum, sB, nterms, scalars, tables, windows);
+    ge_tobytes(checker, &sum);
+
+    if (!consttime_equal(checker, identity)) {
+        return 0;
+    }
+
+    return i;
+}
+
+int ed25519_verify_batch(ed25519_verify_context *ctxs, size_t n, int *valid) {
+    unsigned char h[GE_MULTI_MAX][64];
+    unsigned char seed[32];
+    int have_seed;
+    int all = 1;
+    size_t pos = 0;
+    size_t nh = 0;
+    size_t taken;
+    size_t i;
+
+#ifdef ED25519_NO_SEED
+    have_seed = 0;
+#else
+    have_seed = ed25519_create_seed(seed) == 0;
+#endif
+
+    while (pos < n) {
+        for (; nh < GE_MULTI_MAX && pos + nh < n; ++nh) {
+            sha512_final(&ctxs[pos + nh].hash, h[nh]);
+        }
+
+        taken = have_seed ? verify_batch_step(h, ctxs + pos, nh, seed, pos) : 0;
+
+        if (taken > 0) {
+            for (i = 0; i < taken; ++i) {
+                valid[pos + i] = 1;
+            }
+        } else {
+            /* something in here is bad (or there's no randomness to batch
+               with), so find out what one at a time */
+            taken = nh;
+
+            for (i = 0; i < taken; ++i) {
+                const ed25519_verify_context *ctx = &ctxs[pos + i];
+
+                if (ctx->fixed_key) {
+                    valid[pos + i] = verify_hram_fixed(ctx->signature, h[i], ctx->fixed_key);
+                } else {
+                    valid[pos + i] = verify_hram(ctx->signature, h[i], ctx->public_key);
+                }
+
+                all &= valid[pos + i];
+            }
+        }
+
+        memmove(h, h + taken, (nh - taken) * sizeof h[0]);
+        nh -= taken;
+        pos += taken;
+    }
+
+    return all;
+}
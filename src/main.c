@@ -4,9 +4,13 @@
 #include <string.h>
 #include <math.h>
 
+#include "arena.h"
+#include "cache.h"
 #include "common.h"
 #include "config.h"
 #include "demo.h"
+#include "ed25519/ed25519.h"
+#include "rules.h"
 
 #define DEMO_DIR "demos"
 #define ERR_FILE "errors.txt"
@@ -18,12 +22,15 @@
 #define FILESUM_WHITELIST_FILE "filesum_whitelist.txt"
 #define VPK_DIRECTORIES_WHITELIST_FILE "vpk_directories_whitelist.txt"
 #define GENERAL_CONF_FILE "config.txt"
+#define VERIFY_CACHE_FILE "verify_cache.txt"
+#define STDIN_NAME "<stdin>"
+#define PARALLEL_HASH_MIN_SIZE (32 << 20)
 
 FILE *g_errfile;
 FILE *g_outfile;
 
-static char **g_cmd_whitelist;
-static char **g_sar_sum_whitelist;
+static struct cmd_whitelist *g_cmd_whitelist;
+static struct sum_whitelist *g_sar_sum_whitelist;
 static struct var_whitelist *g_filesum_whitelist;
 static struct var_whitelist *g_vpk_directories_whitelist;
 static struct var_whitelist *g_cvar_whitelist;
@@ -38,68 +45,85 @@ struct {
 	bool show_wait; // should we show when 'wait' was run?
 	bool show_splits; // should we show split times?
 	int show_netmessages; // 0 = don't show, 1 = show all except srtimer, 2 = show all
+	bool verify_cache; // should directory mode remember checksums between runs?
 } g_config;
 
+// Built-in rules {{{
+
+// The tables in rules.h are laid out so every key sits in the slot its hash
+// under the table's seed picks, so a lookup is one hash and one compare. They
+// come from tools/gen_rules.py, which uses the same hash as this.
+static size_t _rule_slot(uint32_t seed, const char *key) {
+	uint32_t h = 2166136261u ^ seed;
+	while (*key) {
+		h ^= (uint8_t)*key++;
+		h *= 16777619u;
+	}
+	return (h ^ h >> 16) & (RULE_SLOTS - 1);
+}
+
+#define FILESUM_EXT_MAX 16
+
 static bool _allow_initial_cvar(const char *var, const char *val) {
-#define ALLOW(x, y) if (!strcmp(var, #x) && !strcmp(val, y)) return true
-#define ALLOWINT(x, y) if (!strcmp(var, #x) && atoi(val) == y) return true
-#define ALLOWRANGE(x, y, z) if (!strcmp(var, #x) && atoi(val) >= y && atoi(val) <= z) return true
-
-	ALLOWINT(host_timescale, 1);
-	ALLOWINT(sv_alternateticks, 1);
-	ALLOWINT(sv_allow_mobile_portals, 0);
-	ALLOWINT(sv_portal_placement_debug, 0);
-	ALLOWINT(cl_cmdrate, 30);
-	ALLOWINT(cl_updaterate, 20);
-	ALLOWRANGE(cl_fov, 45, 140);
-	ALLOWRANGE(fps_max, 30, 999);
-	ALLOW(sv_use_trace_duration, "0.5");
-	ALLOW(m_yaw, "0.022");
+	const struct cvar_rule *rule = &_g_cvar_rules[_rule_slot(CVAR_RULE_SEED, var)];
+	if (!rule->name || strcmp(rule->name, var)) return false;
 
-	return false;
+	if (rule->val) return !strcmp(val, rule->val);
 
-#undef ALLOW
-#undef ALLOWINT
-#undef ALLOWRANGE
+	int n = atoi(val);
+	return n >= rule->min && n <= rule->max;
 }
 
 static bool _ignore_filesum(const char *path) {
-	// hack to deal with the fact that older sar versions included way
-	// more filesums than now
-	size_t len = strlen(path);
-	const char *end = path + len;
-	if (len > 3 && !strcasecmp(end - 3, ".so")) return true;
-	if (len > 4 && !strcasecmp(end - 4, ".dll")) return true;
-	if (len > 4 && !strcasecmp(end - 4, ".bsp")) return true;
-	if (len > 4 && !strcasecmp(end - 4, ".vpk")) {
-		if (!strncmp(path, "./portal2_dlc1/", 15)) return true;
-		if (!strncmp(path, "./portal2_dlc2/", 15)) return true;
-		if (!strncmp(path, "portal2_dlc1/", 13)) return true;
-		if (!strncmp(path, "portal2_dlc2/", 13)) return true;
+	// the extension is everything from the last dot, which can't start the path
+	const char *dot = strrchr(path, '.');
+	if (!dot || dot == path) return false;
+
+	char ext[FILESUM_EXT_MAX];
+	size_t len = 0;
+	for (const char *c = dot; *c; ++c) {
+		if (len == FILESUM_EXT_MAX - 1) return false;
+		ext[len++] = *c >= 'A' && *c <= 'Z' ? *c - 'A' + 'a' : *c;
+	}
+	ext[len] = 0;
+
+	const struct filesum_rule *rule = &_g_filesum_rules[_rule_slot(FILESUM_RULE_SEED, ext)];
+	if (!rule->ext || strcmp(rule->ext, ext)) return false;
+
+	if (!rule->prefixes) return true;
+	for (const char *const *prefix = rule->prefixes; *prefix; ++prefix) {
+		if (!strncmp(path, *prefix, strlen(*prefix))) return true;
 	}
 	return false;
 }
 
-static int _check_vpk_directory_whitelist(const char *path, const char *sum) {
-	if (!g_vpk_directories_whitelist) return 0;
+// }}}
 
-	bool found = false;
-	for (struct var_whitelist *entry = g_vpk_directories_whitelist; entry->var_name; ++entry) {
-		size_t path_len = strlen(path);
-		size_t entry_len = strlen(entry->var_name);
-		if (path_len < entry_len) continue;
-		if (strcmp(entry->var_name, "*") && strcmp(path + path_len - entry_len, entry->var_name)) continue;
+// which of the expected maps any demo so far has been on
+static struct expected_maps *_g_expected_maps;
+static struct map_found _g_maps_found;
 
-		found = true;
-		if (!entry->val || !strcmp(entry->val, "*") || !strcmp(entry->val, sum)) return 2;
-	}
+// shared by every demo we parse, so a batch reuses the same memory
+static struct arena _g_demo_arena;
 
-	return found ? 1 : 0;
-}
+// only the messages the current config can print; built once the config is read
+static struct demo_filter _g_demo_filter;
+
+// When there's only one demo to look at, big ones get hashed on other threads
+// while we parse
+static bool _g_parallel_hash;
 
-// janky hack lol
-static const char *const _g_map_found = "_MAP_FOUND";
-static const char **_g_expected_maps;
+// In directory mode, each signed demo's v2 signature is checked before the demo
+// is run, along with the rest of its batch
+static const struct demo_sig *_g_presig;
+
+// Also in directory mode, what checking each demo came to is remembered in
+// VERIFY_CACHE_FILE between runs. While a demo is being run, these are its
+// identity and, if the cache had it, its checksum.
+static struct cache *_g_cache;
+static const struct util_file_id *_g_cache_id;
+static bool _g_has_cached_crc;
+static uint32_t _g_cached_crc;
 
 static bool _g_detected_timescale;
 static int _g_num_timescale;
@@ -216,7 +240,7 @@ static void _output_sar_data(struct demo *demo, uint32_t tick, struct sar_data d
 			bool printed = false;
 			for (size_t i = 0; i < data.vpk_checksum.nentries; ++i) {
 				snprintf(strbuf, sizeof strbuf, "%08X", data.vpk_checksum.entries[i].sum);
-				int whitelist_status = _check_vpk_directory_whitelist(data.vpk_checksum.entries[i].path, strbuf);
+				int whitelist_status = config_check_var_whitelist(g_vpk_directories_whitelist, data.vpk_checksum.entries[i].path, strbuf);
 				if (whitelist_status == 1 || (whitelist_status == 0 && g_config.file_sum_mode == 2)) {
 					if (!printed) {
 						fprintf(g_outfile, "\t\t[%5u] [SAR] VPK \"%s\" has checksum %08X\n", tick, data.vpk_checksum.path, data.vpk_checksum.sum);
@@ -325,11 +349,11 @@ static char *base92_decode(const char *encoded, int len) {
 
 ///// END BASE92 /////
 
-static bool handleMessage(struct demo_msg *msg) {
+static bool handleMessage(const struct demo_msg *msg) {
 	if (strncmp(msg->con_cmd, "say \"", 5)) return false;
 	if (strlen(msg->con_cmd) < 10) return false;
 	bool has_prefix = true;
-	char *prefix = msg->con_cmd + 5;
+	const char *prefix = msg->con_cmd + 5;
 	bool cont, orange;
 	if (!strncmp(prefix, SAR_MSG_INIT_B, 4)) {
 		cont = false;
@@ -405,7 +429,7 @@ static bool handleMessage(struct demo_msg *msg) {
 	return true;
 }
 
-static void _output_msg(struct demo *demo, struct demo_msg *msg) {
+static void _output_msg(struct demo *demo, const struct demo_msg *msg) {
 	switch (msg->type) {
 	case DEMO_MSG_CONSOLE_CMD:
 		if (!config_check_cmd_whitelist(g_cmd_whitelist, msg->con_cmd)) {
@@ -414,14 +438,68 @@ static void _output_msg(struct demo *demo, struct demo_msg *msg) {
 			}
 		}
 		break;
-	case DEMO_MSG_SAR_DATA:
-		_output_sar_data(demo, msg->tick, msg->sar_data);
+	case DEMO_MSG_SAR_DATA: {
+		struct sar_data data;
+		demo_decode_sar(demo, msg, &data);
+		_output_sar_data(demo, msg->tick, data);
 		break;
+	}
 	default:
 		break;
 	}
 }
 
+// Mirrors _output_msg and _output_sar_data: every type those might print is
+// kept, and everything else is skipped at parse time.
+static void _init_demo_filter(void) {
+	struct demo_filter *f = &_g_demo_filter;
+	memset(f, 0, sizeof *f);
+
+	demo_filter_add_msg(f, DEMO_MSG_CONSOLE_CMD);
+	demo_filter_add_msg(f, DEMO_MSG_SAR_DATA);
+
+	demo_filter_add_sar(f, SAR_DATA_INVALID);
+	demo_filter_add_sar(f, SAR_DATA_TIMESCALE_CHEAT);
+	demo_filter_add_sar(f, SAR_DATA_PAUSE);
+	demo_filter_add_sar(f, SAR_DATA_ENTITY_SERIAL);
+	demo_filter_add_sar(f, SAR_DATA_FRAMETIME);
+	demo_filter_add_sar(f, SAR_DATA_TIMESTAMP);
+	demo_filter_add_sar(f, SAR_DATA_QUEUEDCMD);
+
+	if (g_config.initial_cvar_mode != 0) demo_filter_add_sar(f, SAR_DATA_INITIAL_CVAR);
+	if (g_config.show_wait) {
+		demo_filter_add_sar(f, SAR_DATA_WAIT_RUN);
+		demo_filter_add_sar(f, SAR_DATA_HWAIT_RUN);
+	}
+	if (g_config.show_splits) {
+		demo_filter_add_sar(f, SAR_DATA_SPEEDRUN_TIME);
+		if (g_config.show_incomplete_speedrun_summaries) demo_filter_add_sar(f, SAR_DATA_SPEEDRUN_TIME_INCOMPLETE);
+	}
+	if (g_config.file_sum_mode != 0) {
+		demo_filter_add_sar(f, SAR_DATA_FILE_CHECKSUM);
+		demo_filter_add_sar(f, SAR_DATA_VPK_CHECKSUM);
+	}
+	if (g_config.show_speedrun_identifier) demo_filter_add_sar(f, SAR_DATA_SPEEDRUN_ID);
+
+	// the trailing checksum is always decoded and handed back separately
+}
+
+static void _mark_map_found(const char *map_name) {
+	config_mark_map_found(_g_expected_maps, &_g_maps_found, map_name);
+}
+
+static void _output_missing_maps(void) {
+	bool did_hdr = false;
+	for (size_t i = 0; i < config_expected_maps_count(_g_expected_maps); ++i) {
+		if (config_is_map_found(&_g_maps_found, i)) continue;
+		if (!did_hdr) {
+			did_hdr = true;
+			fputs("missing maps:\n", g_outfile);
+		}
+		fprintf(g_outfile, "\t%s\n", config_expected_map_name(_g_expected_maps, i));
+	}
+}
+
 static void _validate_checksum(uint32_t demo_given, uint32_t sar_given, uint32_t demo_real) {
 	bool demo_matches = demo_given == demo_real;
 	if (demo_matches) {
@@ -437,37 +515,43 @@ static void _validate_checksum(uint32_t demo_given, uint32_t sar_given, uint32_t
 	}
 }
 
-void run_demo(const char *path) {
-	struct demo *demo = demo_parse(path);
-
+static void _run_demo(const char *path, struct demo *demo) {
 	if (!demo) {
 		fputs("failed to parse demo!\n", g_errfile);
+		arena_reset(&_g_demo_arena);
 		return;
 	}
 
 	bool has_csum = false;
 
+	if (demo->corrupted) {
+		fputs("THE FOLLOWING DEMO IS CORRUPTED. PARSING AS MUCH AS POSSIBLE\n", g_outfile);
+	}
 	fprintf(g_outfile, "demo: '%s'\n", path);
 	fprintf(g_outfile, "\t'%s' on %s - %.2f TPS - %d ticks\n", demo->hdr.client_name, demo->hdr.map_name, demo->tickrate, demo->hdr.playback_ticks);
 	fprintf(g_outfile, "\tevents:\n");
-	for (size_t i = 0; i < demo->nmsgs; ++i) {
-		struct demo_msg *msg = demo->msgs[i];
-		if (i == demo->nmsgs - 1 && msg->type == DEMO_MSG_SAR_DATA && msg->sar_data.type == SAR_DATA_CHECKSUM) {
-			// ending checksum data - validate it
-			_validate_checksum(msg->sar_data.checksum.demo_sum, msg->sar_data.checksum.sar_sum, demo->checksum);
-			has_csum = true;
-		} else {
-			// normal message
-			_output_msg(demo, msg);
-		}
+	struct demo_msg msg;
+	while (demo_next(demo, &msg)) {
+		_output_msg(demo, &msg);
+	}
+	demo_close(demo);
+
+	if (_g_cache_id && !_g_has_cached_crc && demo->trailing_sum.type == SAR_DATA_CHECKSUM) {
+		struct cache_entry entry = { .id = *_g_cache_id, .kind = CACHE_CRC, .crc = demo->checksum };
+		cache_put(_g_cache, &entry);
+	}
+
+	if (demo->trailing_sum.type == SAR_DATA_CHECKSUM) {
+		// ending checksum data - validate it
+		_validate_checksum(demo->trailing_sum.checksum.demo_sum, demo->trailing_sum.checksum.sar_sum, demo->checksum);
+		has_csum = true;
 	}
 
 	if (demo->v2sum_state == V2SUM_INVALID) {
 		fprintf(g_outfile, "\tdemo v2 checksum FAIL\n");
 	} else if (demo->v2sum_state == V2SUM_VALID) {
 		if (g_config.show_passing_checksums) fprintf(g_outfile, "\tdemo v2 checksum PASS\n");
-		struct demo_msg *msg = demo->msgs[demo->nmsgs - 1];
-		uint32_t sar_sum = msg->sar_data.checksum_v2.sar_sum;
+		uint32_t sar_sum = demo->trailing_sum.checksum_v2.sar_sum;
 		if (config_check_sum_whitelist(g_sar_sum_whitelist, sar_sum)) {
 			if (g_config.show_passing_checksums) fprintf(g_outfile, "\tSAR checksum PASS (%X)\n", sar_sum);
 		} else {
@@ -475,27 +559,241 @@ void run_demo(const char *path) {
 		}
 	}
 
-	if (_g_expected_maps) {
-		for (size_t i = 0; _g_expected_maps[i]; ++i) {
-			if (_g_expected_maps[i] == _g_map_found) continue; // This pointer equality check is intentional
-			if (!strcmp(_g_expected_maps[i], demo->hdr.map_name)) {
-				_g_expected_maps[i] = _g_map_found;
-			}
-		}
-	}
+	_mark_map_found(demo->hdr.map_name);
 
 	if (!has_csum && demo->v2sum_state == V2SUM_NONE) {
 		fputs("\tno checksums found; vanilla demo?\n", g_outfile);
 	}
 
 	demo_free(demo);
+	arena_reset(&_g_demo_arena);
+}
+
+static void _run_opened_demo(const char *path, struct demo *demo) {
+	if (demo && _g_presig) {
+		demo_use_sig(demo, _g_presig);
+	}
+	if (demo && _g_has_cached_crc) {
+		demo_use_checksum(demo, _g_cached_crc);
+	}
+	if (demo && _g_parallel_hash && demo->file.size >= PARALLEL_HASH_MIN_SIZE) {
+		demo_hash_in_background(demo, util_cpu_count());
+	}
+	_run_demo(path, demo);
+}
+
+void run_demo(const char *path) {
+	_run_opened_demo(path, demo_open(path, &_g_demo_arena, &_g_demo_filter));
+}
+
+// For demos piped in rather than sitting on disk
+static void _run_demo_stdin(void) {
+	size_t size;
+	uint8_t *buf = util_read_stream(stdin, &size);
+	if (!buf) {
+		fputs("failed to read demo from stdin\n", g_errfile);
+		return;
+	}
+
+	_run_demo(STDIN_NAME, demo_open_buffer(STDIN_NAME, buf, size, &_g_demo_arena, &_g_demo_filter));
+
+	free(buf);
+}
+
+// Calls fn on every demo in DEMO_DIR, along with its position in the listing.
+// Returns false if the folder couldn't be opened.
+static bool _for_each_demo(void (*fn)(const char *path, size_t i)) {
+	DIR *d = opendir(DEMO_DIR);
+	if (!d) {
+		fprintf(g_errfile, "failed to open demos folder '%s'\n", DEMO_DIR);
+		return false;
+	}
+
+	size_t demo_dir_len = strlen(DEMO_DIR);
+	struct dirent *ent;
+	size_t i = 0;
+	while ((ent = readdir(d))) {
+		if (!strcmp(ent->d_name, ".")) continue;
+		if (!strcmp(ent->d_name, "..")) continue;
+
+		char *path = malloc(demo_dir_len + strlen(ent->d_name) + 2);
+		strcpy(path, DEMO_DIR);
+		strcat(path, "/");
+		strcat(path, ent->d_name);
+
+		fn(path, i++);
+
+		free(path);
+	}
+
+	closedir(d);
+	return true;
+}
+
+// Demos are run SIG_BATCH_SIZE at a time. Each batch is mapped and its v2
+// signatures hashed side by side and checked together, which is much cheaper
+// than checking each one as it's run; then the demos are run in order on the
+// same mappings, so none is read twice.
+#define SIG_BATCH_SIZE 64
+
+// a demo waiting to be run, and what's known about it so far
+struct _dir_demo {
+	char *path;
+	size_t i; // its position in the listing
+	bool has_id;
+	struct util_file_id id;
+	bool mapped;
+	struct util_mapping map;
+	enum {
+		SIG_PENDING,
+		SIG_DONE,
+		SIG_NONE, // not signed
+	} state;
+	struct demo_sig sig;
+	bool has_crc; // from the cache
+	uint32_t crc;
+};
+
+static struct _dir_demo _g_dir_demos[SIG_BATCH_SIZE];
+static size_t _g_ndir_demos;
+
+static void _cache_sig(const struct _dir_demo *d) {
+	if (!d->has_id) return;
+	struct cache_entry entry = { .id = d->id, .kind = CACHE_SIG, .sig = d->sig };
+	cache_put(_g_cache, &entry);
+}
+
+static void _check_dir_sigs(void) {
+	static ed25519_verify_context ctxs[SIG_BATCH_SIZE];
+	struct util_mapping maps[SIG_BATCH_SIZE];
+	size_t items[SIG_BATCH_SIZE];
+	struct demo_sig sigs[SIG_BATCH_SIZE];
+	size_t which[SIG_BATCH_SIZE];
+	size_t pending[SIG_BATCH_SIZE];
+	int valid[SIG_BATCH_SIZE];
+
+	size_t nmaps = 0;
+	for (size_t i = 0; i < _g_ndir_demos; ++i) {
+		struct _dir_demo *d = &_g_dir_demos[i];
+		if (d->state != SIG_PENDING || !d->mapped) continue;
+		items[nmaps] = i;
+		maps[nmaps++] = d->map;
+	}
+
+	size_t nsigned = nmaps > 0 ? demo_sig_prepare(maps, nmaps, sigs, ctxs, which) : 0;
+
+	// a demo the cache knows by its contents rather than its identity still
+	// had to be hashed, but the verdict can be reused
+	size_t nverify = 0;
+	for (size_t k = 0; k < nsigned; ++k) {
+		struct _dir_demo *d = &_g_dir_demos[items[which[k]]];
+		d->state = SIG_DONE;
+		d->sig = sigs[k];
+
+		const struct cache_entry *known = _g_cache ? cache_find_key(_g_cache, sigs[k].key) : NULL;
+		if (known) {
+			d->sig.valid = known->sig.valid;
+			_cache_sig(d);
+		} else {
+			ctxs[nverify] = ctxs[k];
+			pending[nverify++] = items[which[k]];
+		}
+	}
+
+	if (nverify > 0) ed25519_verify_batch(ctxs, nverify, valid);
+
+	for (size_t j = 0; j < nverify; ++j) {
+		struct _dir_demo *d = &_g_dir_demos[pending[j]];
+		d->sig.valid = valid[j];
+		_cache_sig(d);
+	}
+}
+
+static void _run_dir_demo(struct _dir_demo *d) {
+	if (d->i > 0) {
+		fputs("\n", g_outfile);
+	}
+
+	_g_detected_timescale = false;
+	_g_presig = d->state == SIG_DONE ? &d->sig : NULL;
+	_g_cache_id = d->has_id ? &d->id : NULL;
+	_g_has_cached_crc = d->has_crc;
+	_g_cached_crc = d->crc;
+
+	if (d->mapped) {
+		_run_opened_demo(d->path, demo_open_mapping(d->path, &d->map, &_g_demo_arena, &_g_demo_filter));
+	} else {
+		// demo_open says why it can't be read
+		run_demo(d->path);
+	}
+
+	_g_presig = NULL;
+	_g_cache_id = NULL;
+	_g_has_cached_crc = false;
+}
+
+static void _flush_dir_demos(void) {
+	for (size_t i = 0; i < _g_ndir_demos; ++i) {
+		struct _dir_demo *d = &_g_dir_demos[i];
+		d->mapped = util_map_file(d->path, &d->map);
+	}
+
+	_check_dir_sigs();
+
+	for (size_t i = 0; i < _g_ndir_demos; ++i) {
+		struct _dir_demo *d = &_g_dir_demos[i];
+		_run_dir_demo(d);
+		free(d->path);
+	}
+	_g_ndir_demos = 0;
+}
+
+static void _queue_dir_demo(const char *path, size_t i) {
+	struct _dir_demo *d = &_g_dir_demos[_g_ndir_demos++];
+	d->path = malloc(strlen(path) + 1);
+	strcpy(d->path, path);
+	d->i = i;
+	d->state = SIG_PENDING;
+	d->has_crc = false;
+
+	// the identity has to be taken before anything is read, so that a change
+	// after that can only make the cache miss
+	d->has_id = _g_cache && util_file_id(path, &d->id);
+	const struct cache_entry *known = d->has_id ? cache_find(_g_cache, &d->id) : NULL;
+	if (known && known->kind == CACHE_SIG) {
+		d->state = SIG_DONE;
+		d->sig = known->sig;
+	} else if (known) {
+		d->state = SIG_NONE;
+		d->has_crc = true;
+		d->crc = known->crc;
+	}
+
+	if (_g_ndir_demos == SIG_BATCH_SIZE) _flush_dir_demos();
+}
+
+// Just the header, for checking map coverage before doing any real work
+static void _inventory_demo(const char *path, size_t i) {
+	(void)i;
+
+	struct demo_hdr hdr;
+	if (demo_read_header(path, &_g_demo_arena, &hdr) == 0) {
+		fprintf(g_outfile, "%s: %s\n", path, hdr.map_name);
+		_mark_map_found(hdr.map_name);
+	}
+	arena_reset(&_g_demo_arena);
 }
 
 int main(int argc, char **argv) {
 	const char *dem_name = NULL;
+	bool maps_only = false;
 	if (argc == 1) {
 		g_errfile = fopen(ERR_FILE, "w");
 		g_outfile = fopen(OUT_FILE, "w");
+	} else if (argc == 2 && !strcmp(argv[1], "--maps")) {
+		g_errfile = stderr;
+		g_outfile = stdout;
+		maps_only = true;
 	} else if (argc == 2) {
 		g_errfile = stderr;
 		g_outfile = stdout;
@@ -505,15 +803,21 @@ int main(int argc, char **argv) {
 		fprintf(stderr, "Usage:\n");
 		fprintf(stderr, " %s          Traverses every demo in ./demos; outputs to " OUT_FILE " and " ERR_FILE "\n", name);
 		fprintf(stderr, " %s [in.dem] Runs on a specific demo; outputs to stdio\n", name);
+		fprintf(stderr, " %s -        Reads a demo from stdin; outputs to stdio\n", name);
+		fprintf(stderr, " %s --maps   Lists the map of every demo in ./demos, and any missing maps; outputs to stdio\n", name);
 		return 1;
 	}
 
-	_g_expected_maps = (const char **)config_read_newline_sep(EXPECTED_MAPS_FILE);
-	g_cmd_whitelist = config_read_newline_sep(CMD_WHITELIST_FILE);
-	g_sar_sum_whitelist = config_read_newline_sep(SAR_WHITELIST_FILE);
-	g_filesum_whitelist = config_read_var_whitelist(FILESUM_WHITELIST_FILE);
-	g_vpk_directories_whitelist = config_read_var_whitelist(VPK_DIRECTORIES_WHITELIST_FILE);
-	g_cvar_whitelist = config_read_var_whitelist(CVAR_WHITELIST_FILE);
+	arena_init(&_g_demo_arena);
+	demo_init();
+
+	_g_expected_maps = config_read_expected_maps(EXPECTED_MAPS_FILE);
+	config_init_map_found(&_g_maps_found, _g_expected_maps);
+	g_cmd_whitelist = config_read_cmd_whitelist(CMD_WHITELIST_FILE);
+	g_sar_sum_whitelist = config_read_sum_whitelist(SAR_WHITELIST_FILE);
+	g_filesum_whitelist = config_read_var_whitelist(FILESUM_WHITELIST_FILE, false);
+	g_vpk_directories_whitelist = config_read_var_whitelist(VPK_DIRECTORIES_WHITELIST_FILE, true);
+	g_cvar_whitelist = config_read_var_whitelist(CVAR_WHITELIST_FILE, false);
 
 	g_config.file_sum_mode = 2;
 	g_config.initial_cvar_mode = 2;
@@ -523,10 +827,11 @@ int main(int argc, char **argv) {
 	g_config.show_wait = true;
 	g_config.show_splits = true;
 	g_config.show_netmessages = 2;
-	struct var_whitelist *general_conf = config_read_var_whitelist(GENERAL_CONF_FILE);
+	g_config.verify_cache = true;
+	struct config_var *general_conf = config_read_vars(GENERAL_CONF_FILE);
 	if (general_conf) {
-		for (struct var_whitelist *ptr = general_conf; ptr->var_name; ++ptr) {
-			if (!strcmp(ptr->var_name, "file_sum_mode")) {
+		for (struct config_var *ptr = general_conf; ptr->name; ++ptr) {
+			if (!strcmp(ptr->name, "file_sum_mode")) {
 				int val = atoi(ptr->val);
 				if (val < 0) val = 0;
 				if (val > 2) val = 2;
@@ -534,7 +839,7 @@ int main(int argc, char **argv) {
 				continue;
 			}
 
-			if (!strcmp(ptr->var_name, "initial_cvar_mode")) {
+			if (!strcmp(ptr->name, "initial_cvar_mode")) {
 				int val = atoi(ptr->val);
 				if (val < 0) val = 0;
 				if (val > 2) val = 2;
@@ -542,37 +847,37 @@ int main(int argc, char **argv) {
 				continue;
 			}
 
-			if (!strcmp(ptr->var_name, "show_passing_checksums")) {
+			if (!strcmp(ptr->name, "show_passing_checksums")) {
 				int val = atoi(ptr->val);
 				g_config.show_passing_checksums = val != 0;
 				continue;
 			}
 
-			if (!strcmp(ptr->var_name, "show_speedrun_identifier")) {
+			if (!strcmp(ptr->name, "show_speedrun_identifier")) {
 				int val = atoi(ptr->val);
 				g_config.show_speedrun_identifier = val != 0;
 				continue;
 			}
 
-			if (!strcmp(ptr->var_name, "show_incomplete_speedrun_summaries")) {
+			if (!strcmp(ptr->name, "show_incomplete_speedrun_summaries")) {
 				int val = atoi(ptr->val);
 				g_config.show_incomplete_speedrun_summaries = val != 0;
 				continue;
 			}
 
-			if (!strcmp(ptr->var_name, "show_wait")) {
+			if (!strcmp(ptr->name, "show_wait")) {
 				int val = atoi(ptr->val);
 				g_config.show_wait = val != 0;
 				continue;
 			}
 
-			if (!strcmp(ptr->var_name, "show_splits")) {
+			if (!strcmp(ptr->name, "show_splits")) {
 				int val = atoi(ptr->val);
 				g_config.show_splits = val != 0;
 				continue;
 			}
 
-			if (!strcmp(ptr->var_name, "show_netmessages")) {
+			if (!strcmp(ptr->name, "show_netmessages")) {
 				int val = atoi(ptr->val);
 				if (val < 0) val = 0;
 				if (val > 2) val = 2;
@@ -580,68 +885,55 @@ int main(int argc, char **argv) {
 				continue;
 			}
 
-			fprintf(g_errfile, "bad config option '%s'\n", ptr->var_name);
+			if (!strcmp(ptr->name, "verify_cache")) {
+				int val = atoi(ptr->val);
+				g_config.verify_cache = val != 0;
+				continue;
+			}
+
+			fprintf(g_errfile, "bad config option '%s'\n", ptr->name);
 		}
-		config_free_var_whitelist(general_conf);
+		config_free_vars(general_conf);
 	}
 
+	_init_demo_filter();
+
 	if (dem_name) {
-		run_demo(dem_name);
+		if (!strcmp(dem_name, "-")) {
+			_run_demo_stdin();
+		} else {
+			_g_parallel_hash = true;
+			run_demo(dem_name);
+		}
 		if (_g_detected_timescale) {
 			fputs("\nTIMESCALE DETECTED\n", g_outfile);
 		}
+	} else if (maps_only) {
+		_for_each_demo(_inventory_demo);
 	} else {
-		DIR *d = opendir(DEMO_DIR);
-		if (d) {
-			size_t demo_dir_len = strlen(DEMO_DIR);
-			struct dirent *ent;
-			bool is_first = true;
-			while ((ent = readdir(d))) {
-				if (!strcmp(ent->d_name, ".")) continue;
-				if (!strcmp(ent->d_name, "..")) continue;
-
-				if (!is_first) {
-					fputs("\n", g_outfile);
-				}
-
-				is_first = false;
-
-				char *path = malloc(demo_dir_len + strlen(ent->d_name) + 2);
-				strcpy(path, DEMO_DIR);
-				strcat(path, "/");
-				strcat(path, ent->d_name);
-
-				_g_detected_timescale = false;
-				run_demo(path);
-
-				free(path);
-			}
-
-			closedir(d);
-		} else {
-			fprintf(g_errfile, "failed to open demos folder '%s'\n", DEMO_DIR);
+		if (g_config.verify_cache) _g_cache = cache_load(VERIFY_CACHE_FILE);
+		if (_for_each_demo(_queue_dir_demo)) {
+			_flush_dir_demos();
+		}
+		if (_g_cache) {
+			cache_save(_g_cache);
+			cache_free(_g_cache);
 		}
-
 		fprintf(g_outfile, "\ntimescale detected on %u demos\n", _g_num_timescale);
 	}
 
-	if (_g_expected_maps) {
-		bool did_hdr = false;
-		for (size_t i = 0; _g_expected_maps[i]; ++i) {
-			if (_g_expected_maps[i] == _g_map_found) continue; // This pointer equality check is intentional
-			if (!did_hdr) {
-				did_hdr = true;
-				fputs("missing maps:\n", g_outfile);
-			}
-			fprintf(g_outfile, "\t%s\n", _g_expected_maps[i]);
-		}
-	}
+	_output_missing_maps();
+
+	arena_destroy(&_g_demo_arena);
+	demo_shutdown();
 
-	config_free_newline_sep(g_cmd_whitelist);
-	config_free_newline_sep(g_sar_sum_whitelist);
+	config_free_cmd_whitelist(g_cmd_whitelist);
+	config_free_sum_whitelist(g_sar_sum_whitelist);
 	config_free_var_whitelist(g_filesum_whitelist);
 	config_free_var_whitelist(g_vpk_directories_whitelist);
 	config_free_var_whitelist(g_cvar_whitelist);
+	config_free_expected_maps(_g_expected_maps);
+	config_free_map_found(&_g_maps_found);
 
 	fclose(g_errfile);
 	fclose(g_outfile);
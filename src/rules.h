@@ -0,0 +1,51 @@
+// Generated by tools/gen_rules.py; edit the rules there and run
+// `make tables` rather than changing this file.
+
+#ifndef RULES_H
+#define RULES_H
+
+#define RULE_SLOTS 32
+
+// Initial cvar values allowed regardless of the whitelist: either exactly
+// val, or with no val, any integer in [min, max].
+struct cvar_rule {
+	const char *name;
+	const char *val;
+	int min, max;
+};
+
+#define CVAR_RULE_SEED 1u
+
+static const struct cvar_rule _g_cvar_rules[RULE_SLOTS] = {
+	[7] = { .name = "fps_max", .min = 30, .max = 999 },
+	[8] = { .name = "sv_alternateticks", .min = 1, .max = 1 },
+	[9] = { .name = "sv_allow_mobile_portals", .min = 0, .max = 0 },
+	[11] = { .name = "sv_portal_placement_debug", .min = 0, .max = 0 },
+	[15] = { .name = "host_timescale", .min = 1, .max = 1 },
+	[17] = { .name = "sv_use_trace_duration", .val = "0.5" },
+	[19] = { .name = "cl_updaterate", .min = 20, .max = 20 },
+	[23] = { .name = "cl_fov", .min = 45, .max = 140 },
+	[24] = { .name = "cl_cmdrate", .min = 30, .max = 30 },
+	[29] = { .name = "m_yaw", .val = "0.022" },
+};
+
+// hack to deal with the fact that older sar versions included way more
+// filesums than now: files with these extensions (in lowercase) aren't
+// shown, or if there's a list of prefixes, only ones under one of them
+struct filesum_rule {
+	const char *ext;
+	const char *const *prefixes;
+};
+
+static const char *const _g_dlc_prefixes[] = { "./portal2_dlc1/", "./portal2_dlc2/", "portal2_dlc1/", "portal2_dlc2/", NULL };
+
+#define FILESUM_RULE_SEED 1u
+
+static const struct filesum_rule _g_filesum_rules[RULE_SLOTS] = {
+	[3] = { .ext = ".dll" },
+	[6] = { .ext = ".bsp" },
+	[7] = { .ext = ".so" },
+	[21] = { .ext = ".vpk", .prefixes = _g_dlc_prefixes },
+};
+
+#endif
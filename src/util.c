@@ -3,6 +3,22 @@
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600 // for GetFileInformationByHandleEx
+#endif
+#include <fcntl.h>
+#include <io.h>
+#include <windows.h>
+#else
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #include "util.h"
 
 void util_strip_whitespace(char *str) {
@@ -24,3 +40,256 @@ bool util_is_prefix_i(const char *prefix, const char *str) {
 	}
 	return true;
 }
+
+#ifdef _WIN32
+
+bool util_map_file(const char *path, struct util_mapping *out) {
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(file, &size) || (uint64_t)size.QuadPart > SIZE_MAX) {
+		CloseHandle(file);
+		return false;
+	}
+
+	out->data = NULL;
+	out->size = size.QuadPart;
+
+	if (out->size == 0) {
+		CloseHandle(file);
+		return true;
+	}
+
+	HANDLE map = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	CloseHandle(file);
+	if (!map) return false;
+
+	// the view keeps the mapping object alive
+	out->data = MapViewOfFile(map, FILE_MAP_READ, 0, 0, 0);
+	CloseHandle(map);
+
+	return out->data != NULL;
+}
+
+void util_unmap_file(struct util_mapping *map) {
+	if (map->data) UnmapViewOfFile(map->data);
+	map->data = NULL;
+	map->size = 0;
+}
+
+// FILETIMEs count 100ns intervals since 1601, rather than since 1970
+#define FILETIME_UNIX_EPOCH UINT64_C(116444736000000000)
+
+static int64_t _filetime_ns(uint64_t ft) {
+	return ((int64_t)ft - (int64_t)FILETIME_UNIX_EPOCH) * 100;
+}
+
+bool util_file_id(const char *path, struct util_file_id *out) {
+	HANDLE file = CreateFileA(path, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, 0, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	BY_HANDLE_FILE_INFORMATION info;
+	FILE_BASIC_INFO basic;
+	bool ok =
+		GetFileInformationByHandle(file, &info) &&
+		GetFileInformationByHandleEx(file, FileBasicInfo, &basic, sizeof basic);
+	CloseHandle(file);
+	if (!ok || (info.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) return false;
+
+	out->dev = info.dwVolumeSerialNumber;
+	out->ino = (uint64_t)info.nFileIndexHigh << 32 | info.nFileIndexLow;
+	out->size = (uint64_t)info.nFileSizeHigh << 32 | info.nFileSizeLow;
+	out->mtime_ns = _filetime_ns((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32 | info.ftLastWriteTime.dwLowDateTime);
+	out->ctime_ns = _filetime_ns(basic.ChangeTime.QuadPart);
+	return true;
+}
+
+bool util_replace_file(const char *from, const char *to) {
+	return MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING);
+}
+
+unsigned long util_process_id(void) {
+	return GetCurrentProcessId();
+}
+
+bool util_lock_file(const char *path, struct util_lock *out) {
+	HANDLE file = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_ALWAYS, 0, NULL);
+	if (file == INVALID_HANDLE_VALUE) return false;
+
+	OVERLAPPED at = { 0 };
+	if (!LockFileEx(file, LOCKFILE_EXCLUSIVE_LOCK, 0, 1, 0, &at)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	out->handle = file;
+	return true;
+}
+
+void util_unlock_file(struct util_lock *lock) {
+	// closing the handle would release it too, but only eventually
+	OVERLAPPED at = { 0 };
+	UnlockFileEx(lock->handle, 0, 1, 0, &at);
+	CloseHandle(lock->handle);
+}
+
+static DWORD WINAPI _thread_main(LPVOID arg) {
+	struct util_thread *thread = arg;
+	thread->fn(thread->arg);
+	return 0;
+}
+
+bool util_thread_start(struct util_thread *thread, void (*fn)(void *arg), void *arg) {
+	thread->fn = fn;
+	thread->arg = arg;
+	thread->handle = CreateThread(NULL, 0, _thread_main, thread, 0, NULL);
+	return thread->handle != NULL;
+}
+
+void util_thread_join(struct util_thread *thread) {
+	WaitForSingleObject(thread->handle, INFINITE);
+	CloseHandle(thread->handle);
+}
+
+unsigned util_cpu_count(void) {
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors > 0 ? info.dwNumberOfProcessors : 1;
+}
+
+#else
+
+bool util_map_file(const char *path, struct util_mapping *out) {
+	int fd = open(path, O_RDONLY);
+	if (fd == -1) return false;
+
+	struct stat st;
+	if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode)) {
+		close(fd);
+		return false;
+	}
+
+	out->data = NULL;
+	out->size = st.st_size;
+
+	if (out->size == 0) {
+		close(fd);
+		return true;
+	}
+
+	void *data = mmap(NULL, out->size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) return false;
+
+	// we walk the demo front to back exactly once
+	madvise(data, out->size, MADV_SEQUENTIAL);
+
+	out->data = data;
+	return true;
+}
+
+void util_unmap_file(struct util_mapping *map) {
+	if (map->data) munmap((void *)map->data, map->size);
+	map->data = NULL;
+	map->size = 0;
+}
+
+bool util_file_id(const char *path, struct util_file_id *out) {
+	struct stat st;
+	if (stat(path, &st) == -1 || !S_ISREG(st.st_mode)) return false;
+
+	out->dev = st.st_dev;
+	out->ino = st.st_ino;
+	out->size = st.st_size;
+	out->mtime_ns = (int64_t)st.st_mtim.tv_sec * 1000000000 + st.st_mtim.tv_nsec;
+	out->ctime_ns = (int64_t)st.st_ctim.tv_sec * 1000000000 + st.st_ctim.tv_nsec;
+	return true;
+}
+
+bool util_replace_file(const char *from, const char *to) {
+	return rename(from, to) == 0;
+}
+
+unsigned long util_process_id(void) {
+	return getpid();
+}
+
+bool util_lock_file(const char *path, struct util_lock *out) {
+	int fd = open(path, O_RDWR | O_CREAT, 0666);
+	if (fd == -1) return false;
+
+	int ret;
+	while ((ret = flock(fd, LOCK_EX)) == -1 && errno == EINTR);
+	if (ret == -1) {
+		close(fd);
+		return false;
+	}
+
+	out->fd = fd;
+	return true;
+}
+
+void util_unlock_file(struct util_lock *lock) {
+	// the lock goes with the descriptor
+	close(lock->fd);
+}
+
+static void *_thread_main(void *arg) {
+	struct util_thread *thread = arg;
+	thread->fn(thread->arg);
+	return NULL;
+}
+
+bool util_thread_start(struct util_thread *thread, void (*fn)(void *arg), void *arg) {
+	thread->fn = fn;
+	thread->arg = arg;
+	return pthread_create(&thread->handle, NULL, _thread_main, thread) == 0;
+}
+
+void util_thread_join(struct util_thread *thread) {
+	pthread_join(thread->handle, NULL);
+}
+
+unsigned util_cpu_count(void) {
+	long n = sysconf(_SC_NPROCESSORS_ONLN);
+	return n > 0 ? n : 1;
+}
+
+#endif
+
+uint8_t *util_read_stream(FILE *f, size_t *size) {
+#ifdef _WIN32
+	// otherwise CRLFs and ^Z get mangled
+	_setmode(_fileno(f), _O_BINARY);
+#endif
+
+	size_t alloc = 1 << 20;
+	size_t len = 0;
+	uint8_t *buf = malloc(alloc);
+	if (!buf) return NULL;
+
+	while (true) {
+		if (len == alloc) {
+			alloc *= 2;
+			uint8_t *new_buf = realloc(buf, alloc);
+			if (!new_buf) {
+				free(buf);
+				return NULL;
+			}
+			buf = new_buf;
+		}
+
+		size_t n = fread(buf + len, 1, alloc - len, f);
+		len += n;
+		if (n == 0) break;
+	}
+
+	if (ferror(f)) {
+		free(buf);
+		return NULL;
+	}
+
+	*size = len;
+	return buf;
+}
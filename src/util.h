@@ -2,8 +2,77 @@
 #define UTIL_H
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#ifndef _WIN32
+#include <pthread.h>
+#endif
+
+struct util_mapping {
+	const uint8_t *data;
+	size_t size;
+};
 
 void util_strip_whitespace(char *str);
 bool util_is_prefix_i(const char *prefix, const char *str);
 
+// Maps a whole file read-only into memory. Empty files give a NULL mapping of
+// size 0, which util_unmap_file accepts.
+bool util_map_file(const char *path, struct util_mapping *out);
+void util_unmap_file(struct util_mapping *map);
+
+// Everything that has to stay the same for a file's contents to be assumed
+// unchanged without reading them. The change time can't be set back by hand
+// the way the modification time can, so both go in.
+struct util_file_id {
+	uint64_t dev;
+	uint64_t ino;
+	uint64_t size;
+	int64_t mtime_ns;
+	int64_t ctime_ns;
+};
+
+bool util_file_id(const char *path, struct util_file_id *out);
+// Renames from to to, replacing to in one step if it already exists, so
+// anyone opening to gets either the old file or the new one in full.
+bool util_replace_file(const char *from, const char *to);
+unsigned long util_process_id(void);
+
+// An exclusive lock on path, which cooperating processes take before touching
+// some other file they share. It's only advisory: nothing stops anyone else
+// opening the file. The file is created if need be, and left behind.
+struct util_lock {
+#ifdef _WIN32
+	void *handle;
+#else
+	int fd;
+#endif
+};
+
+// Waits until the lock is ours; returns false if it can't be had at all.
+bool util_lock_file(const char *path, struct util_lock *out);
+void util_unlock_file(struct util_lock *lock);
+
+// Just enough threading to run a function in the background and wait for it.
+// The struct has to stay put until util_thread_join.
+struct util_thread {
+	void (*fn)(void *arg);
+	void *arg;
+#ifdef _WIN32
+	void *handle;
+#else
+	pthread_t handle;
+#endif
+};
+
+bool util_thread_start(struct util_thread *thread, void (*fn)(void *arg), void *arg);
+void util_thread_join(struct util_thread *thread);
+unsigned util_cpu_count(void);
+
+// Reads everything left in a stream (e.g. stdin) into a malloc'd buffer. For
+// when there's no file to map; returns NULL on failure.
+uint8_t *util_read_stream(FILE *f, size_t *size);
+
 #endif
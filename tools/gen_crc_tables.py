@@ -0,0 +1,118 @@
+#!/usr/bin/env python3
+# Generates src/crc_table.h, the lookup tables and folding constants crc32.c
+# uses for the standard (IEEE) CRC32. Run `make tables` to regenerate it.
+
+POLY = 0xEDB88320  # P, bit reflected
+SLICES = 16
+
+
+def crc_byte(b):
+    crc = b
+    for _ in range(8):
+        crc = crc >> 1 ^ POLY if crc & 1 else crc >> 1
+    return crc
+
+
+def multmodp(a, b):
+    # like _multmodp in crc32.c: a * b mod P, both reflected
+    m = 1 << 31
+    p = 0
+    while m:
+        if a & m:
+            p ^= b
+        m >>= 1
+        b = b >> 1 ^ POLY if b & 1 else b >> 1
+    return p
+
+
+def xpow(n):
+    # x^n mod P, reflected
+    p = 1 << 31
+    x = 1 << 30  # x^1
+    while n:
+        if n & 1:
+            p = multmodp(x, p)
+        x = multmodp(x, x)
+        n >>= 1
+    return p
+
+
+def fold(n):
+    # x^n mod P as the carry-less multiply kernels want it: reflected and
+    # shifted left by one
+    return xpow(n) << 1
+
+
+def barrett_mu():
+    # floor(x^64 / P), 33 bits, reflected
+    p = 1 << 32 | int("{:032b}".format(POLY)[::-1], 2)
+    q = 0
+    r = 1 << 64
+    for i in range(32, -1, -1):
+        if r >> (i + 32) & 1:
+            q |= 1 << i
+            r ^= p << i
+    return int("{:033b}".format(q)[::-1], 2)
+
+
+def table_rows(vals, indent):
+    return [indent + " ".join("0x%08X," % v for v in vals[i:i + 4]) for i in range(0, len(vals), 4)]
+
+
+def main():
+    out = []
+    w = out.append
+
+    w("// Generated by tools/gen_crc_tables.py; run `make tables` rather than")
+    w("// changing this file.")
+    w("")
+    w("#ifndef CRC_TABLE_H")
+    w("#define CRC_TABLE_H")
+    w("")
+    w("#include <stdint.h>")
+    w("")
+
+    slices = [[crc_byte(b) for b in range(256)]]
+    for k in range(1, SLICES):
+        prev = slices[-1]
+        slices.append([prev[b] >> 8 ^ slices[0][prev[b] & 0xFF] for b in range(256)])
+    w("// _g_crc_slice_table[k][b] is the CRC contribution of byte b followed by k zero")
+    w("// bytes, which lets crc32_update fold in %d bytes per step. Row 0 on its own" % SLICES)
+    w("// is the usual byte-at-a-time table.")
+    w("static const uint32_t _g_crc_slice_table[%d][256] = {" % SLICES)
+    for row in slices:
+        w("\t{")
+        out.extend(table_rows(row, "\t\t"))
+        w("\t},")
+    w("};")
+    w("")
+
+    w("// _g_crc_x2n_table[n] is x^(2^n) mod P, bit reflected like the CRC itself, for")
+    w("// crc32_combine to shift a CRC past any number of zero bytes.")
+    w("static const uint32_t _g_crc_x2n_table[32] = {")
+    out.extend(table_rows([xpow(1 << n) for n in range(32)], "\t"))
+    w("};")
+    w("")
+
+    w("// The carry-less multiply kernels fold the data down into a 128-bit")
+    w("// remainder by multiplying what's been accumulated by x^n mod P, where n is")
+    w("// how far ahead the next block is, and XORing in that block. Each pair is")
+    w("// (x^(n+32) mod P, x^(n-32) mod P), bit reflected and shifted left by one,")
+    w("// for the low and high halves of a lane.")
+    for n in (128, 256, 384, 512, 2048):
+        w("#define FOLD_%d 0x%09X, 0x%09X" % (n, fold(n + 32), fold(n - 32)))
+    w("")
+    w("// x^64 mod P, for the 128 to 64 bit step")
+    w("#define FOLD_64 0x%09X" % fold(64))
+    w("")
+    w("// Barrett reduction: P' and mu = x^64 / P")
+    w("#define BARRETT_P 0x%09X" % (POLY << 1 | 1))
+    w("#define BARRETT_MU 0x%09X" % barrett_mu())
+    w("")
+    w("#endif")
+
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+# Generates src/rules.h, the built-in initial cvar and filesum rules laid out
+# as perfect hash tables: each table comes with a seed under which every key
+# hashes to its own slot, so main.c looks a key up with one hash and one
+# compare. Edit the rules here, then run `make tables`.
+
+import sys
+
+SLOTS = 32
+
+# name: exact value (a string), or an inclusive integer range
+CVAR_RULES = {
+    "host_timescale": (1, 1),
+    "sv_alternateticks": (1, 1),
+    "sv_allow_mobile_portals": (0, 0),
+    "sv_portal_placement_debug": (0, 0),
+    "cl_cmdrate": (30, 30),
+    "cl_updaterate": (20, 20),
+    "cl_fov": (45, 140),
+    "fps_max": (30, 999),
+    "sv_use_trace_duration": "0.5",
+    "m_yaw": "0.022",
+}
+
+# lowercase extension: None to ignore every such file, or the name of a list
+# of path prefixes to only ignore ones under
+FILESUM_RULES = {
+    ".so": None,
+    ".dll": None,
+    ".bsp": None,
+    ".vpk": "_g_dlc_prefixes",
+}
+
+PREFIX_LISTS = {
+    "_g_dlc_prefixes": ["./portal2_dlc1/", "./portal2_dlc2/", "portal2_dlc1/", "portal2_dlc2/"],
+}
+
+
+# must match _rule_slot in main.c
+def rule_slot(seed, key):
+    h = 2166136261 ^ seed
+    for b in key.encode():
+        h ^= b
+        h = h * 16777619 & 0xFFFFFFFF
+    return (h ^ h >> 16) & (SLOTS - 1)
+
+
+def find_seed(keys):
+    for seed in range(1 << 16):
+        slots = {rule_slot(seed, k) for k in keys}
+        if len(slots) == len(keys):
+            return seed
+    sys.exit("no perfect hash for " + ", ".join(keys))
+
+
+def c_str(s):
+    return '"' + s.replace("\\", "\\\\").replace('"', '\\"') + '"'
+
+
+def main():
+    out = []
+    w = out.append
+
+    w("// Generated by tools/gen_rules.py; edit the rules there and run")
+    w("// `make tables` rather than changing this file.")
+    w("")
+    w("#ifndef RULES_H")
+    w("#define RULES_H")
+    w("")
+    w("#define RULE_SLOTS %d" % SLOTS)
+    w("")
+
+    cvar_seed = find_seed(list(CVAR_RULES))
+    w("// Initial cvar values allowed regardless of the whitelist: either exactly")
+    w("// val, or with no val, any integer in [min, max].")
+    w("struct cvar_rule {")
+    w("\tconst char *name;")
+    w("\tconst char *val;")
+    w("\tint min, max;")
+    w("};")
+    w("")
+    w("#define CVAR_RULE_SEED %du" % cvar_seed)
+    w("")
+    w("static const struct cvar_rule _g_cvar_rules[RULE_SLOTS] = {")
+    for name, rule in sorted(CVAR_RULES.items(), key=lambda r: rule_slot(cvar_seed, r[0])):
+        slot = rule_slot(cvar_seed, name)
+        if isinstance(rule, str):
+            w("\t[%d] = { .name = %s, .val = %s }," % (slot, c_str(name), c_str(rule)))
+        else:
+            w("\t[%d] = { .name = %s, .min = %d, .max = %d }," % (slot, c_str(name), rule[0], rule[1]))
+    w("};")
+    w("")
+
+    filesum_seed = find_seed(list(FILESUM_RULES))
+    w("// hack to deal with the fact that older sar versions included way more")
+    w("// filesums than now: files with these extensions (in lowercase) aren't")
+    w("// shown, or if there's a list of prefixes, only ones under one of them")
+    w("struct filesum_rule {")
+    w("\tconst char *ext;")
+    w("\tconst char *const *prefixes;")
+    w("};")
+    w("")
+    for name, prefixes in PREFIX_LISTS.items():
+        w("static const char *const %s[] = { %s, NULL };" % (name, ", ".join(c_str(p) for p in prefixes)))
+    w("")
+    w("#define FILESUM_RULE_SEED %du" % filesum_seed)
+    w("")
+    w("static const struct filesum_rule _g_filesum_rules[RULE_SLOTS] = {")
+    for ext, prefixes in sorted(FILESUM_RULES.items(), key=lambda r: rule_slot(filesum_seed, r[0])):
+        slot = rule_slot(filesum_seed, ext)
+        if prefixes:
+            w("\t[%d] = { .ext = %s, .prefixes = %s }," % (slot, c_str(ext), prefixes))
+        else:
+            w("\t[%d] = { .ext = %s }," % (slot, c_str(ext)))
+    w("};")
+    w("")
+    w("#endif")
+
+    print("\n".join(out))
+
+
+if __name__ == "__main__":
+    main()